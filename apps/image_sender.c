@@ -1,10 +1,18 @@
 #include "../lib/libc/libc.h"
 #include "../lib/libhydra/hydra.h"
 #include "../lib/libnet/libnet.h"
+#include "../kernal/syscall.h"
+#include "../kernal/ipc.h"
 #include "raytracer/raytracer.h"
 
 #define DEFAULT_PORT 8080
-#define CHUNK_SIZE 512
+#define CHUNK_SIZE MAX_MESSAGE_SIZE  // send() carries at most one message
+#define UDP_CHUNK_DELAY_MS 2  // Pacing between broadcast chunks
+
+// EDF reservation pacing the broadcast: one chunk per period, each with a
+// bounded send time, instead of a sleep that drifts with the load
+#define UDP_CHUNK_RUNTIME_US 500
+#define UDP_CHUNK_PERIOD_US  (UDP_CHUNK_DELAY_MS * 1000)
 
 // Simple HTTP-like response for serving images
 void send_http_response(int client_sock, const char *content_type, 
@@ -19,18 +27,21 @@ void send_http_response(int client_sock, const char *content_type,
         content_type, data_size);
     
     // Send header
-    send(client_sock, header, header_len, 0);
+    if (send(client_sock, header, header_len, 0) < 0) {
+        printf("Failed to send header\n");
+        return;
+    }
     
-    // Send data in chunks
+    // Send data in chunks; send() returns 0 once the chunk is queued
     int sent = 0;
     while (sent < data_size) {
         int chunk_size = (data_size - sent > CHUNK_SIZE) ? CHUNK_SIZE : (data_size - sent);
         int result = send(client_sock, data + sent, chunk_size, 0);
-        if (result <= 0) {
+        if (result < 0) {
             printf("Failed to send data chunk at offset %d\n", sent);
             break;
         }
-        sent += result;
+        sent += chunk_size;
         printf("Sent %d/%d bytes\n", sent, data_size);
     }
 }
@@ -201,23 +212,36 @@ void udp_image_broadcast_demo(void) {
     int sent = 0;
     int chunk_size = 64;  // Small chunks for UDP
     
+    int self = syscall_get_pid();
+    int paced = syscall_sched_edf(self, UDP_CHUNK_RUNTIME_US, UDP_CHUNK_PERIOD_US, 0) == 0;
+    if (!paced) {
+        printf("No EDF reservation, pacing with sleeps\n");
+    }
+    
     while (sent < test_size) {
         int current_chunk = (test_size - sent > chunk_size) ? chunk_size : (test_size - sent);
         
         int result = sendto(udp_sock, test_image + sent, current_chunk, 0,
                            (struct sockaddr*)&broadcast_addr, sizeof(broadcast_addr));
         
-        if (result <= 0) {
+        if (result < 0) {
             printf("Failed to send UDP chunk at offset %d\n", sent);
             break;
         }
         
-        sent += result;
+        sent += current_chunk;
         printf("Broadcasted %d/%d bytes\n", sent, test_size);
         
-        // Small delay between chunks to avoid overwhelming the network
-        // (In a real OS, we'd use proper timing)
-        for (volatile int i = 0; i < 100000; i++) { }
+        // Pace the chunks to avoid overwhelming the network
+        if (paced) {
+            syscall_edf_yield();
+        } else {
+            syscall_sleep_ms(UDP_CHUNK_DELAY_MS);
+        }
+    }
+    
+    if (paced) {
+        syscall_sched_edf(self, 0, 0, 0);
     }
     
     printf("UDP broadcast complete - sent %d bytes total\n", sent + header_len);
@@ -0,0 +1,518 @@
+#include "../kernal/syscall.h"
+#include "../kernal/ipc.h"
+#include "../kernal/printk.h"
+#include "../kernal/sched.h"
+#include "../kernal/mm.h"
+
+// IPC benchmark suite. Every result is printed as one machine-parseable line
+//   BENCH <metric> <value> <unit>
+// where lower is better; bench_compare.sh checks them against a baseline.
+// Cases that also verify what was delivered print
+//   CHECK <name> ok|FAIL
+// and any FAIL fails the comparison.
+// Built into the boot path with -DBENCH_IPC by 'make bench-ipc'.
+
+#define BENCH_RTT_ROUNDS     200
+#define BENCH_ONEWAY_MSGS    256
+#define BENCH_FANIN_CLIENTS  3
+#define BENCH_FANIN_MSGS     64   // Per client
+#define BENCH_RECV_BATCH     8
+#define BENCH_SEND_BATCH     8
+#define BENCH_CREDIT_DEPTH   2    // Driver queue depth while the fan-in clients flood it
+#define BENCH_MCAST_SUBS     3
+#define BENCH_MCAST_EVENTS   16   // Per round; below the default queue depth, so none may be skipped
+#define BENCH_MCAST_ROUNDS   8
+#define BENCH_MCAST_SIZE     64
+#define BENCH_EDF_RUNTIME_US 500
+#define BENCH_EDF_PERIOD_US  2000
+#define BENCH_EDF_PERIODS    20
+#define BENCH_EDF_OVER_US    950  // Per 1000us: above the EDF_BW_MAX admission bound
+#define BENCH_SLAB_OBJECT    48   // Not a kmalloc size, so the cache is a dedicated one
+#define BENCH_TASK_CYCLES    (MAX_TASKS + 64) // Short-lived tasks created in turn: more than there are slots
+#define BENCH_TASK_SCRATCH   256  // Stack each of them dirties before checking its guard words
+#define BENCH_STALL_MS       1000 // Give up on a phase after this long without progress
+
+// First word of every benchmark message
+#define BENCH_OP_ECHO 1  // Server replies to the PID in the second word
+#define BENCH_OP_SINK 2  // Server drops the message
+#define BENCH_OP_EVENT 3 // Multicast event; the second word is its sequence number
+#define BENCH_OP_END   4 // Multicast end of round: subscribers report what they saw
+
+#define BENCH_NOTIFY_GO 0x1  // Starts a fan-in burst on the clients
+
+static const int bench_sizes[] = { 8, 32, 64, 128, MAX_MESSAGE_SIZE };
+#define NUM_BENCH_SIZES ((int)(sizeof(bench_sizes) / sizeof(bench_sizes[0])))
+
+static const unsigned int bench_stack_sizes[] = { 2048, TASK_STACK_SIZE, 8192 };
+#define NUM_BENCH_STACKS ((int)(sizeof(bench_stack_sizes) / sizeof(bench_stack_sizes[0])))
+
+static int bench_server_pid = -1;
+static int bench_fast_pid = -1;
+static int bench_driver_pid = -1;
+static int bench_clients[BENCH_FANIN_CLIENTS];
+static int bench_num_clients = 0;
+static int bench_subs[BENCH_MCAST_SUBS];
+static int bench_num_subs = 0;
+static struct kmem_cache *bench_cache;
+
+static struct task_stats bench_stats[MAX_TASKS];
+static unsigned char bench_pid_seen[MAX_TASKS];
+
+static inline unsigned long read_cycles(void) {
+    unsigned long cycles;
+    asm volatile("rdcycle %0" : "=r"(cycles));
+    return cycles;
+}
+
+static int bench_check(const char *name, int ok) {
+    printk("CHECK %s %s\n", name, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+// Message-path server: echoes or drops depending on the op word
+static void bench_server(void) {
+    int buffer[MAX_MESSAGE_SIZE / sizeof(int)];
+
+    while (1) {
+        int size = syscall_recv_msg(-1, buffer, sizeof(buffer));
+        if (size >= 2 * (int)sizeof(int) && buffer[0] == BENCH_OP_ECHO) {
+            syscall_send_msg(buffer[1], buffer, size);
+        }
+    }
+}
+
+// Fast-path server: replies with the caller's own registers
+static void bench_fast_server(void) {
+    struct ipc_regs regs;
+    int caller = -1;
+
+    while (1) {
+        caller = syscall_reply_wait(caller, &regs);
+    }
+}
+
+// Fan-in client: sends a burst to the driver each time it is signalled
+static void bench_fanin_client(void) {
+    int msg[2] = { BENCH_OP_SINK, syscall_get_pid() };
+
+    while (1) {
+        syscall_notify_wait(BENCH_NOTIFY_GO, IPC_WAIT_FOREVER);
+        for (int i = 0; i < BENCH_FANIN_MSGS; i++) {
+            syscall_send_msg(bench_driver_pid, msg, sizeof(msg));
+        }
+    }
+}
+
+// Multicast subscriber: counts the events of a round that arrive in order
+// and reports the count to the driver when the round ends
+static void bench_subscriber(void) {
+    int msg[MAX_MESSAGE_SIZE / sizeof(int)];
+    int seen = 0;
+
+    while (1) {
+        int size = syscall_recv_msg(bench_driver_pid, msg, sizeof(msg));
+        if (size != BENCH_MCAST_SIZE) continue;
+
+        if (msg[0] == BENCH_OP_EVENT) {
+            if (msg[1] == seen) seen++;
+        } else if (msg[0] == BENCH_OP_END) {
+            int report[2] = { syscall_get_pid(), seen };
+            syscall_send_msg(bench_driver_pid, report, sizeof(report));
+            seen = 0;
+        }
+    }
+}
+
+// Dirty the stack below the caller's frame, in a frame of its own
+static void __attribute__((noinline)) bench_touch_stack(void) {
+    volatile char scratch[BENCH_TASK_SCRATCH];
+
+    for (int i = 0; i < BENCH_TASK_SCRATCH; i++) {
+        scratch[i] = (char)i;
+    }
+}
+
+// Short-lived task: uses some stack, reports whether the guard words at the
+// bottom of it are intact, and exits by returning
+static void bench_short_task(void) {
+    int pid = syscall_get_pid();
+    struct task *self = &tasks[pid];
+
+    bench_touch_stack();
+
+    int report[2] = { pid, self->stack && stack_intact(self->stack) };
+    syscall_send_msg(bench_driver_pid, report, sizeof(report));
+}
+
+static int echo_round_trip(int size) {
+    int buffer[MAX_MESSAGE_SIZE / sizeof(int)];
+    buffer[0] = BENCH_OP_ECHO;
+    buffer[1] = bench_driver_pid;
+
+    if (syscall_send_msg(bench_server_pid, buffer, size) < 0) return -1;
+    if (syscall_recv_msg_timeout(bench_server_pid, buffer, sizeof(buffer), BENCH_STALL_MS) != size) {
+        return -1;
+    }
+    return 0;
+}
+
+static void bench_rtt(void) {
+    echo_round_trip(8); // warm-up
+
+    unsigned long start = read_cycles();
+    for (int i = 0; i < BENCH_RTT_ROUNDS; i++) {
+        if (echo_round_trip(8) < 0) {
+            printk("[bench] send/recv round trip %d failed\n", i);
+            return;
+        }
+    }
+    printk("BENCH rtt_msg_8 %ld cycles\n", (read_cycles() - start) / BENCH_RTT_ROUNDS);
+
+    struct ipc_regs regs;
+    regs.count = 1;
+    regs.mr[0] = 0;
+    syscall_call(bench_fast_pid, &regs); // warm-up
+
+    start = read_cycles();
+    for (int i = 0; i < BENCH_RTT_ROUNDS; i++) {
+        regs.count = 1;
+        regs.mr[0] = i;
+        if (syscall_call(bench_fast_pid, &regs) < 0) {
+            printk("[bench] call/reply round trip %d failed\n", i);
+            return;
+        }
+    }
+    printk("BENCH rtt_call_8 %ld cycles\n", (read_cycles() - start) / BENCH_RTT_ROUNDS);
+}
+
+// One-way cost: stream messages into the sink, then one echo to know the
+// server has drained them all
+static void bench_oneway(void) {
+    int buffer[MAX_MESSAGE_SIZE / sizeof(int)];
+    buffer[0] = BENCH_OP_SINK;
+    buffer[1] = bench_driver_pid;
+
+    for (int s = 0; s < NUM_BENCH_SIZES; s++) {
+        int size = bench_sizes[s];
+
+        unsigned long start = read_cycles();
+        for (int i = 0; i < BENCH_ONEWAY_MSGS; i++) {
+            if (syscall_send_msg(bench_server_pid, buffer, size) < 0) {
+                printk("[bench] one-way send of %d bytes failed\n", size);
+                return;
+            }
+        }
+        if (echo_round_trip(8) < 0) {
+            printk("[bench] one-way drain of %d bytes failed\n", size);
+            return;
+        }
+
+        printk("BENCH oneway_%d %ld cycles/msg\n", size,
+               (read_cycles() - start) / BENCH_ONEWAY_MSGS);
+    }
+}
+
+// Drain one burst from every fan-in client with batched receives.
+// Returns 0 once all of it has arrived.
+static int drain_fanin(void) {
+    struct ipc_recv_entry entries[BENCH_RECV_BATCH];
+    int buffers[BENCH_RECV_BATCH][2];
+
+    for (int i = 0; i < BENCH_RECV_BATCH; i++) {
+        entries[i].buffer = buffers[i];
+        entries[i].max_size = sizeof(buffers[i]);
+    }
+
+    int expected = bench_num_clients * BENCH_FANIN_MSGS;
+    int received = 0;
+
+    while (received < expected) {
+        int n = syscall_recv_msgv(-1, entries, BENCH_RECV_BATCH, BENCH_STALL_MS);
+        if (n <= 0) {
+            printk("[bench] fan-in stalled after %d/%d messages\n", received, expected);
+            return -1;
+        }
+        received += n;
+    }
+    return 0;
+}
+
+// Batched one-way cost: the same stream as bench_oneway() at 64 bytes, but
+// BENCH_SEND_BATCH messages per SYS_SEND_MSGV, each gathered from a header
+// word and a body
+static void bench_oneway_msgv(void) {
+    int header = BENCH_OP_SINK;
+    int body[64 / sizeof(int) - 1];
+    struct ipc_iovec iov[2] = {
+        { &header, sizeof(header) },
+        { body, sizeof(body) },
+    };
+    struct ipc_send_entry entries[BENCH_SEND_BATCH];
+    int ok = 1;
+
+    body[0] = bench_driver_pid;
+
+    unsigned long start = read_cycles();
+    for (int sent = 0; sent < BENCH_ONEWAY_MSGS && ok; sent += BENCH_SEND_BATCH) {
+        for (int i = 0; i < BENCH_SEND_BATCH; i++) {
+            entries[i].receiver_pid = bench_server_pid;
+            entries[i].iov = iov;
+            entries[i].iov_count = 2;
+            entries[i].result = -1;
+        }
+        if (syscall_send_msgv(entries, BENCH_SEND_BATCH) != BENCH_SEND_BATCH) {
+            ok = 0;
+        }
+        for (int i = 0; i < BENCH_SEND_BATCH; i++) {
+            if (entries[i].result != 0) ok = 0;
+        }
+    }
+    if (echo_round_trip(8) < 0) {
+        ok = 0;
+    }
+    unsigned long cycles = read_cycles() - start;
+
+    if (bench_check("msgv_all_sent", ok)) {
+        printk("BENCH oneway_msgv_64 %ld cycles/msg\n", cycles / BENCH_ONEWAY_MSGS);
+    }
+}
+
+// Fan-in: all clients burst at the driver, which drains with batched receives
+static void bench_fanin(void) {
+    unsigned long start = read_cycles();
+    for (int i = 0; i < bench_num_clients; i++) {
+        syscall_notify(bench_clients[i], BENCH_NOTIFY_GO);
+    }
+
+    if (drain_fanin() < 0) return;
+
+    printk("BENCH fanin_%dx %ld cycles/msg\n", bench_num_clients,
+           (read_cycles() - start) / (bench_num_clients * BENCH_FANIN_MSGS));
+}
+
+// Credit limits: the clients flood a driver queue only BENCH_CREDIT_DEPTH
+// deep and block for credit. A reply from a server the driver is waiting on
+// must still get through the full queue, and every blocked send must
+// complete once the driver drains.
+static void bench_credit(void) {
+    if (syscall_set_queue_depth(BENCH_CREDIT_DEPTH) < 0) {
+        bench_check("credit_depth", 0);
+        return;
+    }
+
+    unsigned long start = read_cycles();
+    for (int i = 0; i < bench_num_clients; i++) {
+        syscall_notify(bench_clients[i], BENCH_NOTIFY_GO);
+    }
+    syscall_sleep_ms(1);  // Let the clients fill the queue and block
+
+    int reply_ok = echo_round_trip(8) == 0;
+    int drain_ok = drain_fanin() == 0;
+    unsigned long cycles = read_cycles() - start;
+
+    syscall_set_queue_depth(IPC_DEFAULT_QUEUE_DEPTH);
+
+    bench_check("credit_reply_on_full_queue", reply_ok);
+    if (bench_check("credit_blocked_senders", drain_ok)) {
+        printk("BENCH credit_%d %ld cycles/msg\n", BENCH_CREDIT_DEPTH,
+               cycles / (bench_num_clients * BENCH_FANIN_MSGS));
+    }
+}
+
+// Multicast: one copy of each event fanned out to every subscriber, which
+// must see all of them in order
+static void bench_multicast(void) {
+    int event[BENCH_MCAST_SIZE / sizeof(int)];
+    int ok = 1;
+
+    unsigned long start = read_cycles();
+    for (int r = 0; r < BENCH_MCAST_ROUNDS && ok; r++) {
+        event[0] = BENCH_OP_EVENT;
+        for (int i = 0; i < BENCH_MCAST_EVENTS; i++) {
+            event[1] = i;
+            if (syscall_multicast(bench_subs, bench_num_subs, event, sizeof(event)) != bench_num_subs) {
+                printk("[bench] multicast event %d of round %d not queued for every subscriber\n", i, r);
+                ok = 0;
+            }
+        }
+
+        event[0] = BENCH_OP_END;
+        if (syscall_multicast(bench_subs, bench_num_subs, event, sizeof(event)) != bench_num_subs) {
+            ok = 0;
+        }
+
+        for (int i = 0; i < bench_num_subs; i++) {
+            int report[2] = { 0, -1 };
+            if (syscall_recv_msg_timeout(bench_subs[i], report, sizeof(report), BENCH_STALL_MS) != sizeof(report) ||
+                report[1] != BENCH_MCAST_EVENTS) {
+                printk("[bench] subscriber %d saw %d/%d events in round %d\n",
+                       bench_subs[i], report[1], BENCH_MCAST_EVENTS, r);
+                ok = 0;
+            }
+        }
+    }
+    unsigned long cycles = read_cycles() - start;
+
+    if (bench_check("multicast_delivery", ok)) {
+        printk("BENCH mcast_%dx %ld cycles/event\n", bench_num_subs,
+               cycles / (BENCH_MCAST_ROUNDS * (BENCH_MCAST_EVENTS + 1)));
+    }
+}
+
+// Deadline misses counted for pid so far, or -1 if it is not found
+static long task_misses(int pid) {
+    int n = syscall_task_stats(bench_stats, MAX_TASKS);
+
+    for (int i = 0; i < n; i++) {
+        if (bench_stats[i].pid == pid) return (long)bench_stats[i].deadline_misses;
+    }
+    return -1;
+}
+
+// EDF: a reservation above the admission bound must be refused, and the
+// driver, holding a reservation whose jobs end well within budget, must
+// meet every deadline over several periods
+static void bench_edf(void) {
+    int self = bench_driver_pid;
+
+    int over = syscall_sched_edf(self, BENCH_EDF_OVER_US, 1000, 0);
+    if (over == 0) syscall_sched_edf(self, 0, 0, 0);
+    bench_check("edf_admission_bound", over < 0);
+
+    long before = task_misses(self);
+    if (syscall_sched_edf(self, BENCH_EDF_RUNTIME_US, BENCH_EDF_PERIOD_US, 0) < 0) {
+        bench_check("edf_no_misses", 0);
+        return;
+    }
+
+    for (int i = 0; i < BENCH_EDF_PERIODS; i++) {
+        syscall_edf_yield();
+    }
+    long after = task_misses(self);
+
+    syscall_sched_edf(self, 0, 0, 0);
+
+    bench_check("edf_no_misses", before >= 0 && after == before);
+}
+
+// Slab free checks: freeing an object twice must be refused, and must not
+// leave it on the free list twice to be handed out to two owners
+static void bench_slab_free(void) {
+    // Caches live for good, so the bench keeps one across runs
+    if (!bench_cache) bench_cache = kmem_cache_create("bench-48", BENCH_SLAB_OBJECT);
+    if (!bench_cache) {
+        bench_check("slab_double_free", 0);
+        return;
+    }
+
+    void *a = kmem_cache_alloc(bench_cache);
+    void *b = kmem_cache_alloc(bench_cache);
+    int ok = a && b && a != b;
+
+    if (ok) {
+        ok = kmem_cache_free(bench_cache, a) == 0 &&
+             kmem_cache_free(bench_cache, a) < 0;
+    }
+
+    void *c = kmem_cache_alloc(bench_cache);
+    void *d = kmem_cache_alloc(bench_cache);
+    if (!c || !d || c == d || c == b || d == b) ok = 0;
+
+    kmem_cache_free(bench_cache, b);
+    kmem_cache_free(bench_cache, c);
+    kmem_cache_free(bench_cache, d);
+
+    bench_check("slab_double_free", ok);
+}
+
+// Task churn: create and exit more tasks than there are slots, one at a
+// time, on stacks of several sizes. Every create must get a slot, so slots
+// must be recycled, and every task must find its stack guard intact.
+static void bench_task_churn(void) {
+    int created = 0, intact = 0, reused = 0;
+
+    for (int i = 0; i < MAX_TASKS; i++) {
+        bench_pid_seen[i] = 0;
+    }
+
+    unsigned long start = read_cycles();
+    for (int i = 0; i < BENCH_TASK_CYCLES; i++) {
+        unsigned int size = bench_stack_sizes[i % NUM_BENCH_STACKS];
+
+        // The last task's slot comes back once its hart has switched away
+        int pid = syscall_create_task_stack(bench_short_task, size);
+        for (int waited = 0; pid < 0 && waited < BENCH_STALL_MS; waited++) {
+            syscall_sleep_ms(1);
+            pid = syscall_create_task_stack(bench_short_task, size);
+        }
+        if (pid < 0) {
+            printk("[bench] task %d of %d could not be created\n", i, BENCH_TASK_CYCLES);
+            break;
+        }
+        created++;
+        if (bench_pid_seen[pid]) reused++;
+        bench_pid_seen[pid] = 1;
+
+        int report[2] = { -1, 0 };
+        if (syscall_recv_msg_timeout(pid, report, sizeof(report), BENCH_STALL_MS) != sizeof(report) ||
+            report[0] != pid) {
+            printk("[bench] short-lived task %d did not report\n", pid);
+            break;
+        }
+        if (report[1]) intact++;
+    }
+    unsigned long cycles = read_cycles() - start;
+
+    bench_check("task_slot_reuse", created == BENCH_TASK_CYCLES && reused > 0);
+    if (bench_check("task_stack_guard", created > 0 && intact == created) && created == BENCH_TASK_CYCLES) {
+        printk("BENCH task_churn %ld cycles/task\n", cycles / BENCH_TASK_CYCLES);
+    }
+}
+
+void ipc_bench_run(void) {
+    printk("[bench] IPC benchmark suite starting\n");
+
+    bench_driver_pid = syscall_get_pid();
+
+    // Helper tasks are created once and stay parked between runs
+    if (bench_server_pid < 0) bench_server_pid = syscall_create_task(bench_server);
+    if (bench_fast_pid < 0) bench_fast_pid = syscall_create_task(bench_fast_server);
+    while (bench_num_clients < BENCH_FANIN_CLIENTS) {
+        int pid = syscall_create_task(bench_fanin_client);
+        if (pid < 0) break;
+        bench_clients[bench_num_clients++] = pid;
+    }
+    while (bench_num_subs < BENCH_MCAST_SUBS) {
+        int pid = syscall_create_task(bench_subscriber);
+        if (pid < 0) break;
+        bench_subs[bench_num_subs++] = pid;
+    }
+
+    if (bench_server_pid < 0 || bench_fast_pid < 0) {
+        printk("[bench] Failed to create benchmark servers\n");
+        return;
+    }
+
+    bench_rtt();
+    bench_oneway();
+    bench_oneway_msgv();
+
+    if (bench_num_clients > 0) {
+        bench_fanin();
+        bench_credit();
+    } else {
+        printk("[bench] No task slots left for fan-in clients\n");
+    }
+
+    if (bench_num_subs > 0) {
+        bench_multicast();
+    } else {
+        printk("[bench] No task slots left for multicast subscribers\n");
+    }
+
+    bench_edf();
+    bench_slab_free();
+    bench_task_churn();
+
+    printk("BENCH done 0 -\n");
+}
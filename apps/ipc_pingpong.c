@@ -0,0 +1,100 @@
+#include "../kernal/syscall.h"
+#include "../kernal/ipc.h"
+#include "../kernal/printk.h"
+
+// Ping-pong benchmark: round-trip cost of the send/recv message path versus
+// the SYS_CALL/SYS_REPLY_WAIT fast path
+
+#define PINGPONG_ROUNDS 100
+
+static int msg_echo_pid = -1;
+static int fast_echo_pid = -1;
+
+static inline unsigned long read_cycles(void) {
+    unsigned long cycles;
+    asm volatile("rdcycle %0" : "=r"(cycles));
+    return cycles;
+}
+
+// Echo server for the message path - the first int of each message is the sender PID
+static void msg_echo_server(void) {
+    int buffer[4];
+
+    while (1) {
+        int size = syscall_recv_msg(-1, buffer, sizeof(buffer));
+        if (size >= (int)sizeof(int)) {
+            syscall_send_msg(buffer[0], buffer, size);
+        }
+    }
+}
+
+// Echo server for the fast path - replies with the caller's own registers
+static void fast_echo_server(void) {
+    struct ipc_regs regs;
+    int caller = -1;
+
+    while (1) {
+        caller = syscall_reply_wait(caller, &regs);
+    }
+}
+
+static int msg_round_trip(int server_pid, int seq) {
+    int request[2] = { syscall_get_pid(), seq };
+    int reply[2] = { 0, 0 };
+
+    if (syscall_send_msg(server_pid, request, sizeof(request)) < 0) return -1;
+    if (syscall_recv_msg(server_pid, reply, sizeof(reply)) < 0) return -1;
+
+    return (reply[1] == seq) ? 0 : -1;
+}
+
+static int fast_round_trip(int server_pid, int seq) {
+    struct ipc_regs regs;
+    regs.count = 1;
+    regs.mr[0] = seq;
+
+    if (syscall_call(server_pid, &regs) < 0) return -1;
+
+    return (regs.count == 1 && regs.mr[0] == (unsigned long)seq) ? 0 : -1;
+}
+
+static unsigned long run_rounds(int (*round_trip)(int, int), int server_pid, const char *name) {
+    // Warm-up round so the server is parked in its receive before timing
+    if (round_trip(server_pid, -1) < 0) {
+        printk("[pingpong] %s: warm-up round trip failed\n", name);
+        return 0;
+    }
+
+    unsigned long start = read_cycles();
+    for (int i = 0; i < PINGPONG_ROUNDS; i++) {
+        if (round_trip(server_pid, i) < 0) {
+            printk("[pingpong] %s: round trip %d failed\n", name, i);
+            return 0;
+        }
+    }
+    unsigned long per_round = (read_cycles() - start) / PINGPONG_ROUNDS;
+
+    printk("[pingpong] %s: %d round trips, %ld cycles/round-trip\n",
+           name, PINGPONG_ROUNDS, per_round);
+    return per_round;
+}
+
+void ipc_pingpong_bench(void) {
+    printk("[pingpong] IPC ping-pong benchmark starting\n");
+
+    // Echo servers are created once and stay parked between runs
+    if (msg_echo_pid < 0) msg_echo_pid = syscall_create_task(msg_echo_server);
+    if (fast_echo_pid < 0) fast_echo_pid = syscall_create_task(fast_echo_server);
+
+    if (msg_echo_pid < 0 || fast_echo_pid < 0) {
+        printk("[pingpong] Failed to create echo servers\n");
+        return;
+    }
+
+    unsigned long msg_cycles = run_rounds(msg_round_trip, msg_echo_pid, "send/recv");
+    unsigned long fast_cycles = run_rounds(fast_round_trip, fast_echo_pid, "call/reply");
+
+    if (msg_cycles && fast_cycles) {
+        printk("[pingpong] call/reply fast path is %ldx faster\n", msg_cycles / fast_cycles);
+    }
+}
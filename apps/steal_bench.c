@@ -0,0 +1,95 @@
+#include "../kernal/syscall.h"
+#include "../kernal/ipc.h"
+#include "../kernal/printk.h"
+#include "../kernal/smp.h"
+#include "../kernal/timer.h"
+
+// Work-stealing benchmark: a fixed pile of CPU-bound work units is shared by
+// a few worker tasks. Reports elapsed time plus steals, switches and
+// utilization per hart; run it with different -smp counts to see the scaling.
+
+#define STEAL_WORKERS     3
+#define STEAL_UNITS       96
+#define STEAL_UNIT_SPIN   20000
+#define STEAL_TIMEOUT_MS  10000
+
+#define STEAL_NOTIFY_GO   0x1  // Worker: start taking units
+#define STEAL_NOTIFY_DONE 0x2  // Driver: the last unit finished
+
+static int steal_workers[STEAL_WORKERS];
+static int steal_num_workers = 0;
+static int steal_driver_pid = -1;
+static int units_next;
+static int units_done;
+
+static void steal_worker(void) {
+    while (1) {
+        syscall_notify_wait(STEAL_NOTIFY_GO, IPC_WAIT_FOREVER);
+        
+        while (__atomic_fetch_add(&units_next, 1, __ATOMIC_SEQ_CST) < STEAL_UNITS) {
+            for (volatile int i = 0; i < STEAL_UNIT_SPIN; i++);
+            
+            if (__atomic_add_fetch(&units_done, 1, __ATOMIC_SEQ_CST) == STEAL_UNITS) {
+                syscall_notify(steal_driver_pid, STEAL_NOTIFY_DONE);
+            }
+            
+            // Cooperative scheduling: give tasks sharing this hart a turn
+            syscall_yield();
+        }
+    }
+}
+
+void steal_bench(void) {
+    struct hart_stats before[MAX_HARTS];
+    struct hart_stats after[MAX_HARTS];
+    
+    printk("[steal] Work-stealing benchmark starting\n");
+    
+    steal_driver_pid = syscall_get_pid();
+    
+    // Workers are created once and stay parked between runs
+    while (steal_num_workers < STEAL_WORKERS) {
+        int pid = syscall_create_task(steal_worker);
+        if (pid < 0) break;
+        steal_workers[steal_num_workers++] = pid;
+    }
+    
+    if (steal_num_workers == 0) {
+        printk("[steal] No task slots left for workers\n");
+        return;
+    }
+    
+    __atomic_store_n(&units_next, 0, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&units_done, 0, __ATOMIC_SEQ_CST);
+    
+    for (int i = 0; i < MAX_HARTS; i++) {
+        syscall_hart_stats(i, &before[i]);
+    }
+    
+    unsigned long start = timer_now();
+    for (int i = 0; i < steal_num_workers; i++) {
+        syscall_notify(steal_workers[i], STEAL_NOTIFY_GO);
+    }
+    
+    if (!syscall_notify_wait(STEAL_NOTIFY_DONE, STEAL_TIMEOUT_MS)) {
+        printk("[steal] Timed out with %d/%d units done\n", units_done, STEAL_UNITS);
+        return;
+    }
+    unsigned long elapsed = timer_now() - start;
+    
+    printk("[steal] %d units on %d workers in %ld ticks\n", 
+           STEAL_UNITS, steal_num_workers, elapsed);
+    
+    for (int i = 0; i < MAX_HARTS; i++) {
+        syscall_hart_stats(i, &after[i]);
+        if (!after[i].online) continue;
+        
+        unsigned long idle = after[i].idle_time - before[i].idle_time;
+        unsigned long busy = (idle < elapsed) ? elapsed - idle : 0;
+        
+        printk("[steal] hart %d: steals=%ld switches=%ld util=%ld%%\n", i, 
+               after[i].steals - before[i].steals, 
+               after[i].switches - before[i].switches, 
+               elapsed ? busy * 100 / elapsed : 0);
+    }
+}
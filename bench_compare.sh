@@ -0,0 +1,59 @@
+#!/bin/bash
+
+# Compare IPC benchmark results against a stored baseline
+# Usage: ./bench_compare.sh <results> <baseline> [tolerance-percent]
+# Lines look like "BENCH <metric> <value> <unit>"; lower values are better.
+# "CHECK <name> FAIL" lines from correctness checks fail the comparison too.
+
+RESULTS=${1:-bench_output.txt}
+BASELINE=${2:-bench_ipc_baseline.txt}
+TOLERANCE=${3:-10}
+
+if [ ! -f "$RESULTS" ]; then
+    echo "No benchmark results in $RESULTS"
+    exit 1
+fi
+
+# Correctness failures count with or without a baseline
+if tr -d '\r' < "$RESULTS" | grep '^CHECK [^ ]* FAIL'; then
+    echo "Benchmark correctness checks failed"
+    exit 1
+fi
+
+if [ ! -f "$BASELINE" ]; then
+    echo "No baseline in $BASELINE - run 'make bench-ipc-baseline' first"
+    exit 0
+fi
+
+tr -d '\r' < "$RESULTS" | awk -v tol="$TOLERANCE" -v baseline="$BASELINE" '
+BEGIN {
+    while ((getline line < baseline) > 0) {
+        split(line, f, " ")
+        if (f[1] == "BENCH" && f[2] != "done") base[f[2]] = f[3]
+    }
+    printf "%-16s %12s %12s %8s\n", "metric", "baseline", "current", "delta"
+}
+$1 == "BENCH" && $2 != "done" {
+    seen[$2] = 1
+    if (!($2 in base)) {
+        printf "%-16s %12s %12d %8s  NEW\n", $2, "-", $3, "-"
+        next
+    }
+    delta = (base[$2] > 0) ? ($3 - base[$2]) * 100.0 / base[$2] : 0
+    status = (delta > tol) ? "REGRESSION" : "ok"
+    if (delta > tol) failed++
+    printf "%-16s %12d %12d %+7.1f%%  %s\n", $2, base[$2], $3, delta, status
+}
+END {
+    for (m in base) {
+        if (!(m in seen)) {
+            printf "%-16s %12d %12s %8s  MISSING\n", m, base[m], "-", "-"
+            failed++
+        }
+    }
+    if (failed) {
+        printf "%d metric(s) regressed beyond %d%%\n", failed, tol
+        exit 1
+    }
+    print "All metrics within tolerance"
+}'
@@ -1,8 +1,24 @@
+    .equ MAX_HARTS, 8
+    .equ HART_STACK_SIZE, 16384   # 128K stack area split between MAX_HARTS harts
+
     .section .text
     .globl _start
 _start:
-    # Set up stack pointer (stack grows downwards)
-    la sp, _stack_top
+    # a0 = hart ID (set by OpenSBI, by SBI hart_start, or by QEMU's reset ROM)
+    li  t0, MAX_HARTS
+    bgeu a0, t0, hang
+
+    # Each hart gets its own stack slice below _stack_top (stack grows downwards)
+    la  sp, _stack_top
+    li  t0, HART_STACK_SIZE
+    mul t0, t0, a0
+    sub sp, sp, t0
+
+    # The first hart to get here boots the kernel; the rest park
+    la  t0, boot_lottery
+    li  t1, 1
+    amoswap.w t1, t1, (t0)
+    bnez t1, park
 
     # Clear .bss section
     la  t0, __bss_start
@@ -14,9 +30,28 @@ _start:
     j   1b
 2:
 
-    # Jump to C kernel entry point
+    # Jump to C kernel entry point with the boot hart ID in a0
     call kmain
+    j   hang
+
+# Secondary harts wait here until smp_init() releases them
+park:
+    la  t0, smp_release
+3:
+    lw  t1, 0(t0)
+    beqz t1, 3b
+    fence r, rw
+    call secondary_main
 
 # If kmain ever returns, just spin
 hang:
     j hang
+
+    # Kept out of .bss so clearing it cannot reopen the lottery
+    .section .data
+    .align 2
+boot_lottery:
+    .word 0
+    .globl smp_release
+smp_release:
+    .word 0
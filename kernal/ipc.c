@@ -2,20 +2,94 @@
 #include "printk.h"
 #include "mm.h"
 #include "sched.h"
+#include "timer.h"
+#include "trace.h"
 
-extern int current_task; // Defined in sched.c
+// Per-sender FIFO inside a receiver's queue, so selective receive does not
+// walk other senders' messages. One exists only while the sender has
+// messages queued, found through a small per-receiver hash, so memory is
+// bounded by messages in flight rather than MAX_TASKS squared.
+struct sender_queue {
+    int pid;
+    struct message *head;
+    struct message *tail;
+    struct sender_queue *next;  // Hash chain, or free list link
+};
+
+#define SENDER_BUCKETS 8   // Per receiver, power of two
+
+// ipc_partner of a client whose server exited before replying
+#define IPC_SERVER_EXITED -2
+
+// next_caller of a client the server has taken off its caller queue and
+// owes a reply; only such a client may be replied to
+#define IPC_CALLER_SERVED -2
+
+// next_credit_waiter of a sender that release_credit() has handed a slot
+#define IPC_CREDIT_GRANTED -2
+
+// Message queue for each process. Every message is on the receiver-wide
+// list (arrival order, for "any sender") and on its sender's sub-queue.
+struct msg_queue {
+    struct message *head;
+    struct message *tail;
+    int count;
+    int recv_from;  // Sender a blocked receiver waits for (-1 = any)
+    int max_depth;  // Credit limit: senders block once count reaches this
+    int credit_head, credit_tail; // Senders blocked on this queue, FIFO
+    int granted;    // Slots handed to woken senders that have not posted yet
+    int throttled;  // Times a sender had to wait for credit
+    struct sender_queue *senders[SENDER_BUCKETS];
+};
 
 static struct msg_queue message_queues[MAX_TASKS];
-static struct message *free_messages = 0;
 
-// Debug function to count free messages
-static int count_free_messages(void) {
-    int count = 0;
-    struct message *current = free_messages;
-    while (current) {
-        count++;
-        current = current->next;
+// Every queued message holds its sender's sub-queue, so MAX_MESSAGES of
+// them can never run out
+static struct sender_queue sender_pool[MAX_MESSAGES];
+static struct sender_queue *free_senders;
+static struct grant grants[MAX_GRANTS];
+
+// Message slabs, smallest first. A message is taken from the first class whose
+// payload capacity fits it, so 8-16 byte command words no longer pin a full
+// MAX_MESSAGE_SIZE slot. The last class must cover MAX_MESSAGE_SIZE.
+// Class 0 carries no payload and only backs multicast descriptors.
+static struct msg_slab msg_slabs[] = {
+    { .payload_size = 0,                .initial = 32 },
+    { .payload_size = 32,               .initial = 64 },
+    { .payload_size = 128,              .initial = 16 },
+    { .payload_size = MAX_MESSAGE_SIZE, .initial = 16 },
+};
+
+#define NUM_MSG_SLABS ((int)(sizeof(msg_slabs) / sizeof(msg_slabs[0])))
+
+static int messages_in_use = 0;
+static int multicast_bodies = 0;  // Shared multicast payloads, counted apart from their descriptors
+
+static int slab_object_size(struct msg_slab *slab) {
+    return (sizeof(struct message) + slab->payload_size + 7) & ~7;
+}
+
+// Refill a slab with count messages carved from a single kmalloc chunk
+static int grow_slab(int class, int count) {
+    struct msg_slab *slab = &msg_slabs[class];
+    int object_size = slab_object_size(slab);
+    
+    char *chunk = (char *)kmalloc(object_size * count);
+    if (!chunk) {
+        return 0;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        struct message *msg = (struct message *)(chunk + i * object_size);
+        msg->size_class = class;
+        msg->next = slab->free_list;
+        slab->free_list = msg;
     }
+    
+    slab->total += count;
+    slab->free += count;
+    slab->grows++;
     return count;
 }
 
@@ -27,36 +101,52 @@ void ipc_init(void) {
         message_queues[i].head = 0;
         message_queues[i].tail = 0;
         message_queues[i].count = 0;
+        message_queues[i].recv_from = -1;
+        message_queues[i].max_depth = IPC_DEFAULT_QUEUE_DEPTH;
+        message_queues[i].credit_head = message_queues[i].credit_tail = -1;
+        message_queues[i].granted = 0;
+        message_queues[i].throttled = 0;
+        for (int j = 0; j < SENDER_BUCKETS; j++) {
+            message_queues[i].senders[j] = 0;
+        }
     }
-    printk("[ipc] Message queues initialized for %d tasks\n", MAX_TASKS);
     
-    // Pre-allocate message pool
-    int allocated_messages = 0;
+    free_senders = 0;
     for (int i = 0; i < MAX_MESSAGES; i++) {
-        struct message *msg = (struct message *)kmalloc(sizeof(struct message));
-        if (msg) {
-            msg->next = free_messages;
-            free_messages = msg;
-            allocated_messages++;
-        } else {
-            printk("[ipc] Warning: Failed to allocate message %d/%d\n", i + 1, MAX_MESSAGES);
-        }
+        sender_pool[i].next = free_senders;
+        free_senders = &sender_pool[i];
     }
+    printk("[ipc] Message queues initialized for %d tasks\n", MAX_TASKS);
     
-    printk("[ipc] IPC initialized: %d/%d message slots allocated (size: %d bytes each)\n", 
-           allocated_messages, MAX_MESSAGES, (int)sizeof(struct message));
+    for (int i = 0; i < MAX_GRANTS; i++) {
+        grants[i].in_use = 0;
+        grants[i].generation = 0;
+    }
     
-    if (allocated_messages < MAX_MESSAGES) {
-        printk("[ipc] Warning: Only %d out of %d message slots were allocated\n", 
-               allocated_messages, MAX_MESSAGES);
+    // Pre-allocate each message slab
+    for (int i = 0; i < NUM_MSG_SLABS; i++) {
+        struct msg_slab *slab = &msg_slabs[i];
+        slab->free_list = 0;
+        slab->total = slab->free = slab->peak_in_use = slab->grows = 0;
+        
+        if (!grow_slab(i, slab->initial)) {
+            printk("[ipc] Warning: Failed to preallocate %d-byte message slab\n", 
+                   slab->payload_size);
+            continue;
+        }
+        
+        printk("[ipc] Slab %d: %d messages of %d bytes (%d bytes each with header)\n", 
+               i, slab->total, slab->payload_size, slab_object_size(slab));
     }
+    
+    printk("[ipc] IPC initialized: %d size classes, up to %d messages in flight\n", 
+           NUM_MSG_SLABS, MAX_MESSAGES);
 }
 
-static struct message *alloc_message(void) {
-    if (!free_messages) {
-        int free_count = count_free_messages();
-        printk("[ipc] CRITICAL: Message pool exhausted! (free: %d/%d, all slots in use)\n", 
-               free_count, MAX_MESSAGES);
+static struct message *alloc_message(int size) {
+    if (messages_in_use >= MAX_MESSAGES) {
+        printk("[ipc] CRITICAL: Message limit reached! (%d messages in flight)\n", 
+               messages_in_use);
         
         // Show which tasks have the most messages queued
         printk("[ipc] Current queue status:\n");
@@ -66,20 +156,42 @@ static struct message *alloc_message(void) {
                        i, message_queues[i].count);
             }
         }
-        return 0; // No free messages
+        return 0;
     }
     
-    struct message *msg = free_messages;
-    free_messages = free_messages->next;
-    msg->next = 0;
+    // Smallest class that fits; grow it from the heap when it runs dry and
+    // fall back to a larger class only if the heap is exhausted
+    int class = 0;
+    while (class < NUM_MSG_SLABS && msg_slabs[class].payload_size < size) {
+        class++;
+    }
     
-    // Log allocation details for debugging
-    int remaining = count_free_messages();
-    if (remaining < 10) {
-        printk("[ipc] Low memory warning: Only %d message slots remaining\n", remaining);
+    for (; class < NUM_MSG_SLABS; class++) {
+        struct msg_slab *slab = &msg_slabs[class];
+        
+        if (!slab->free_list && !grow_slab(class, MSG_SLAB_GROW)) {
+            printk("[ipc] Warning: Could not grow %d-byte message slab\n", slab->payload_size);
+            continue;
+        }
+        
+        struct message *msg = slab->free_list;
+        slab->free_list = msg->next;
+        slab->free--;
+        msg->next = 0;
+        msg->refs = 1;
+        msg->payload = msg;
+        
+        int in_use = slab->total - slab->free;
+        if (in_use > slab->peak_in_use) {
+            slab->peak_in_use = in_use;
+        }
+        messages_in_use++;
+        
+        return msg;
     }
     
-    return msg;
+    printk("[ipc] CRITICAL: No memory for a %d-byte message\n", size);
+    return 0;
 }
 
 static void free_message(struct message *msg) {
@@ -93,140 +205,562 @@ static void free_message(struct message *msg) {
     msg->receiver_pid = -1;
     msg->size = 0;
     
-    // Add back to free list
-    msg->next = free_messages;
-    free_messages = msg;
+    // Add back to its slab's free list
+    msg->payload = 0;
+    struct msg_slab *slab = &msg_slabs[msg->size_class];
+    msg->next = slab->free_list;
+    slab->free_list = msg;
+    slab->free++;
+    messages_in_use--;
+}
+
+// Drop one reference to a multicast body, freeing it with the last one
+static void put_message(struct message *msg) {
+    if (--msg->refs == 0) {
+        multicast_bodies--;
+        free_message(msg);
+    }
+}
+
+// Link in queue's hash chain that points at pid's sub-queue (or ends the
+// chain if pid has nothing queued)
+static struct sender_queue **sender_link(struct msg_queue *queue, int pid) {
+    struct sender_queue **link = &queue->senders[pid & (SENDER_BUCKETS - 1)];
+    while (*link && (*link)->pid != pid) {
+        link = &(*link)->next;
+    }
+    return link;
+}
+
+static void enqueue_message(struct msg_queue *queue, struct message *msg) {
+    msg->next = 0;
+    msg->prev = queue->tail;
+    if (queue->tail) {
+        queue->tail->next = msg;
+    } else {
+        queue->head = msg;
+    }
+    queue->tail = msg;
+    
+    struct sender_queue **link = sender_link(queue, msg->sender_pid);
+    struct sender_queue *sq = *link;
+    if (!sq) {
+        sq = free_senders;
+        free_senders = sq->next;
+        sq->pid = msg->sender_pid;
+        sq->head = sq->tail = 0;
+        sq->next = 0;
+        *link = sq;
+    }
     
-    // Log if we're recovering from low memory
-    int free_count = count_free_messages();
-    if (free_count == 10) {  // Just recovered from low memory
-        printk("[ipc] Message slots recovering: %d slots now available\n", free_count);
+    msg->sender_next = 0;
+    if (sq->tail) {
+        sq->tail->sender_next = msg;
+    } else {
+        sq->head = msg;
     }
+    sq->tail = msg;
+    
+    queue->count++;
 }
 
-int send_message(int receiver_pid, const void *data, int size) {
-    printk("[ipc] Send request: PID %d -> PID %d (%d bytes)\n", 
-           current_task, receiver_pid, size);
+// Hand free slots to blocked senders, oldest first. Each woken sender owns
+// its slot until it posts, so a sender arriving meanwhile cannot take it
+// and push the waiter back to the end of the line.
+static void release_credit(struct msg_queue *queue) {
+    while (queue->credit_head >= 0 && queue->count + queue->granted < queue->max_depth) {
+        int waiter = queue->credit_head;
+        
+        queue->credit_head = tasks[waiter].next_credit_waiter;
+        if (queue->credit_head < 0) {
+            queue->credit_tail = -1;
+        }
+        tasks[waiter].next_credit_waiter = IPC_CREDIT_GRANTED;
+        queue->granted++;
+        pi_release(waiter);
+        task_wakeup(waiter, WAIT_SEND);
+    }
+}
+
+// Take pid off queue's credit wait list without granting it a slot
+static void cancel_credit_wait(struct msg_queue *queue, int pid) {
+    int prev = -1;
+    int *link = &queue->credit_head;
+    while (*link >= 0 && *link != pid) {
+        prev = *link;
+        link = &tasks[*link].next_credit_waiter;
+    }
+    if (*link == pid) {
+        *link = tasks[pid].next_credit_waiter;
+        if (queue->credit_tail == pid) {
+            queue->credit_tail = prev;
+        }
+    }
+    tasks[pid].next_credit_waiter = -1;
+    tasks[pid].credit_wait_on = -1;
+}
+
+// Block the current task until receiver_pid's queue has room or the
+// deadline passes
+static void wait_for_credit(int receiver_pid, struct msg_queue *queue, unsigned long deadline) {
+    struct task *self = &tasks[current_task];
+    
+    if (self->credit_wait_on < 0) {
+        self->credit_wait_on = receiver_pid;
+        self->next_credit_waiter = -1;
+        if (queue->credit_tail < 0) {
+            queue->credit_head = queue->credit_tail = current_task;
+        } else {
+            tasks[queue->credit_tail].next_credit_waiter = current_task;
+            queue->credit_tail = current_task;
+        }
+        queue->throttled++;
+    }
+    
+    trace_event(TRACE_IPC_THROTTLE, current_task, receiver_pid, 0, queue->count);
+    
+    // The receiver has to run to drain its queue: lend it our priority
+    pi_wait_on(receiver_pid);
+    task_block(WAIT_SEND, deadline);
+    pi_release(current_task);
+}
+
+// Take the oldest message from sender_pid (-1 = any sender), or 0 if none.
+// Either way the message is the head of its sender's sub-queue, so unlinking
+// it from both lists is O(1) once the sub-queue is found.
+static struct message *dequeue_message(struct msg_queue *queue, int sender_pid) {
+    struct sender_queue **link;
+    struct message *msg;
+    
+    if (sender_pid < 0) {
+        msg = queue->head;
+        if (!msg) return 0;
+        link = sender_link(queue, msg->sender_pid);
+    } else {
+        link = sender_link(queue, sender_pid);
+        if (!*link) return 0;
+        msg = (*link)->head;
+    }
+    
+    struct sender_queue *sq = *link;
+    sq->head = msg->sender_next;
+    if (!sq->head) {
+        // Sender drained: give its sub-queue back
+        *link = sq->next;
+        sq->next = free_senders;
+        free_senders = sq;
+    }
     
+    if (msg->prev) {
+        msg->prev->next = msg->next;
+    } else {
+        queue->head = msg->next;
+    }
+    if (msg->next) {
+        msg->next->prev = msg->prev;
+    } else {
+        queue->tail = msg->prev;
+    }
+    
+    msg->next = msg->prev = msg->sender_next = 0;
+    queue->count--;
+    release_credit(queue);
+    return msg;
+}
+
+static int check_receiver(int receiver_pid) {
     if (receiver_pid < 0 || receiver_pid >= MAX_TASKS) {
         printk("[ipc] ERROR: Invalid receiver PID %d (valid range: 0-%d)\n", 
                receiver_pid, MAX_TASKS - 1);
         return -1;
     }
+    if (tasks[receiver_pid].state == TASK_UNUSED) {
+        printk("[ipc] ERROR: Receiver PID %d does not exist\n", receiver_pid);
+        return -1;
+    }
+    return 0;
+}
+
+// Non-blocking credit check: may a message be queued for receiver_pid now?
+// A receiver blocked waiting for the caller alone always takes it, even past
+// its limit: it will drain the message at once, and holding back a reply to
+// a client that waits for it on a full queue would deadlock both.
+static int credit_available(int receiver_pid, struct msg_queue *queue) {
+    if (queue->recv_from == current_task) {
+        return 1;
+    }
+    if (receiver_pid != current_task && queue->credit_head >= 0) {
+        return 0;  // Blocked senders go first
+    }
+    return queue->count + queue->granted < queue->max_depth;
+}
+
+// Block until receiver_pid's queue has room for one more message, for at
+// most IPC_CREDIT_TIMEOUT_MS
+static int reserve_credit(int receiver_pid, struct msg_queue *queue) {
+    struct task *self = &tasks[current_task];
+    unsigned long deadline = 0;
     
-    if (size <= 0) {
-        printk("[ipc] ERROR: Invalid message size: %d bytes\n", size);
+    while (!credit_available(receiver_pid, queue)) {
+        if (receiver_pid == current_task) {
+            printk("[ipc] ERROR: PID %d queue full (%d messages), cannot send to self\n", 
+                   current_task, queue->count);
+            return -1;
+        }
+        
+        if (!deadline) {
+            deadline = timer_now() + MS_TO_TIMER_TICKS(IPC_CREDIT_TIMEOUT_MS);
+        }
+        wait_for_credit(receiver_pid, queue, deadline);
+        
+        if (tasks[receiver_pid].state == TASK_UNUSED) {
+            return -1;  // Receiver exited while we waited; ipc_task_exit() unlinked us
+        }
+        if (self->next_credit_waiter == IPC_CREDIT_GRANTED) {
+            break;
+        }
+        if (timer_now() >= deadline && !credit_available(receiver_pid, queue)) {
+            cancel_credit_wait(queue, current_task);
+            trace_event(TRACE_IPC_TIMEOUT, current_task, receiver_pid, 0, queue->count);
+            printk("[ipc] ERROR: PID %d queue full (%d messages), send from PID %d timed out\n", 
+                   receiver_pid, queue->count, current_task);
+            return -1;
+        }
+    }
+    
+    if (self->next_credit_waiter == IPC_CREDIT_GRANTED) {
+        // Use the slot release_credit() reserved for us
+        self->next_credit_waiter = -1;
+        self->credit_wait_on = -1;
+        queue->granted--;
+    } else if (self->credit_wait_on >= 0) {
+        // Admitted out of turn: the receiver is waiting for us
+        cancel_credit_wait(queue, current_task);
+    }
+    return 0;
+}
+
+// Per-task traffic counters (SYS_TASK_STATS), kept by the task itself
+static inline void account_send(int bytes) {
+    struct task *task = &tasks[current_task];
+    task->msgs_sent++;
+    task->bytes_sent += bytes;
+}
+
+static inline void account_recv(int bytes) {
+    struct task *task = &tasks[current_task];
+    task->msgs_recv++;
+    task->bytes_recv += bytes;
+}
+
+// Queue msg for receiver_pid and wake the receiver if it is waiting for us
+static void post_message(int receiver_pid, struct msg_queue *queue, struct message *msg) {
+    msg->sender_pid = current_task;
+    msg->receiver_pid = receiver_pid;
+    
+    enqueue_message(queue, msg);
+    account_send(msg->size);
+    
+    if (queue->recv_from < 0 || queue->recv_from == current_task) {
+        // A reply: the receiver stops lending us its priority
+        if (tasks[receiver_pid].pi_waiting_on == current_task) {
+            pi_release(receiver_pid);
+        }
+        task_wakeup(receiver_pid, WAIT_RECV);
+        
+        // Have the scheduler run the receiver when we next block or yield,
+        // on the rest of our slice, typically while we wait for its reply
+        tasks[current_task].handoff_hint = receiver_pid;
+    }
+}
+
+// Gather iov into one message and queue it for receiver_pid.
+// Hot path: only error paths printk, everything else goes to the trace ring.
+static int queue_message(int receiver_pid, const struct ipc_iovec *iov, int iov_count) {
+    if (check_receiver(receiver_pid) < 0) {
         return -1;
     }
     
-    if (size > MAX_MESSAGE_SIZE) {
-        printk("[ipc] ERROR: Message too large: %d bytes (max %d bytes)\n", 
-               size, MAX_MESSAGE_SIZE);
+    int size = 0;
+    for (int i = 0; i < iov_count; i++) {
+        if (!iov[i].base || iov[i].len < 0) {
+            printk("[ipc] ERROR: Null data pointer in send_message\n");
+            return -1;
+        }
+        // Checked per segment so the running total cannot overflow
+        if (iov[i].len > MAX_MESSAGE_SIZE - size) {
+            printk("[ipc] ERROR: Message too large (max %d bytes)\n", MAX_MESSAGE_SIZE);
+            return -1;
+        }
+        size += iov[i].len;
+    }
+    
+    if (size <= 0) {
+        printk("[ipc] ERROR: Invalid message size: %d bytes\n", size);
         return -1;
     }
     
-    if (!data) {
-        printk("[ipc] ERROR: Null data pointer in send_message\n");
+    // Out of credit: wait for the receiver to drain its queue
+    struct msg_queue *queue = &message_queues[receiver_pid];
+    if (reserve_credit(receiver_pid, queue) < 0) {
         return -1;
     }
     
-    struct message *msg = alloc_message();
+    struct message *msg = alloc_message(size);
     if (!msg) {
         printk("[ipc] ERROR: Failed to allocate message for PID %d -> PID %d\n", 
                current_task, receiver_pid);
         return -1;
     }
     
-    // Fill message
-    msg->sender_pid = current_task;
-    msg->receiver_pid = receiver_pid;
     msg->size = size;
     
     // Copy data
-    char *src = (char *)data;
     char *dst = msg->data;
-    for (int i = 0; i < size; i++) {
-        dst[i] = src[i];
+    for (int i = 0; i < iov_count; i++) {
+        const char *src = (const char *)iov[i].base;
+        for (int j = 0; j < iov[i].len; j++) {
+            *dst++ = src[j];
+        }
     }
     
-    // Add to receiver's queue
-    struct msg_queue *queue = &message_queues[receiver_pid];
-    if (!queue->head) {
-        queue->head = queue->tail = msg;
-    } else {
-        queue->tail->next = msg;
-        queue->tail = msg;
+    post_message(receiver_pid, queue, msg);
+    
+    trace_event(TRACE_IPC_SEND, current_task, receiver_pid, size, queue->count);
+    
+    return 0;
+}
+
+// Set the credit limit of the calling task's own queue
+int ipc_set_queue_depth(int depth) {
+    if (depth <= 0 || depth > MAX_MESSAGES) {
+        printk("[ipc] ERROR: Invalid queue depth %d (1-%d)\n", depth, MAX_MESSAGES);
+        return -1;
     }
-    queue->count++;
     
-    printk("[ipc] Message queued: PID %d -> PID %d (%d bytes), queue depth: %d\n", 
-           current_task, receiver_pid, size, queue->count);
+    struct msg_queue *queue = &message_queues[current_task];
+    queue->max_depth = depth;
+    
+    // A larger limit may admit waiting senders straight away
+    release_credit(queue);
     
-    // Warning for high queue depth
-    if (queue->count > 8) {
-        printk("[ipc] WARNING: High queue depth for PID %d: %d messages pending\n", 
-               receiver_pid, queue->count);
+    return 0;
+}
+
+int send_message(int receiver_pid, const void *data, int size) {
+    struct ipc_iovec iov = { data, size };
+    return queue_message(receiver_pid, &iov, 1);
+}
+
+// Send a batch of messages in one kernel entry. Each entry's iovec is gathered
+// into a single message; per-entry status goes to entries[i].result.
+// Returns the number of messages sent.
+int send_message_vector(struct ipc_send_entry *entries, int count) {
+    if (!entries || count <= 0 || count > IPC_MAX_BATCH) {
+        printk("[ipc] ERROR: Invalid send vector (%d entries, max %d)\n", count, IPC_MAX_BATCH);
+        return -1;
     }
     
-    // Critical warning for very high queue depth
-    if (queue->count > 20) {
-        printk("[ipc] CRITICAL: PID %d queue severely backlogged with %d messages!\n", 
-               receiver_pid, queue->count);
+    int sent = 0;
+    for (int i = 0; i < count; i++) {
+        struct ipc_send_entry *entry = &entries[i];
+        
+        if (!entry->iov || entry->iov_count <= 0 || entry->iov_count > IPC_MAX_IOV) {
+            entry->result = -1;
+            continue;
+        }
+        
+        entry->result = queue_message(entry->receiver_pid, entry->iov, entry->iov_count);
+        if (entry->result == 0) {
+            sent++;
+        }
     }
     
-    return 0;
+    return sent;
 }
 
-int recv_message(int sender_pid, void *buffer, int max_size) {
-    int current_pid = current_task;
+// Send one payload to every PID in receivers. The data is copied once into a
+// shared message; each receiver gets a descriptor pointing at it, and the last
+// receiver to take its copy frees it. Never blocks: a receiver whose queue is
+// out of credit is skipped, so one slow subscriber cannot stall the rest.
+// Returns the number of receivers the message was queued for.
+int multicast_message(const int *receivers, int count, const void *data, int size) {
+    if (!receivers || count <= 0 || count > MAX_MULTICAST) {
+        printk("[ipc] ERROR: Invalid multicast receiver set (%d receivers)\n", count);
+        return -1;
+    }
     
-    printk("[ipc] Receive request: PID %d waiting for message from PID %d (max %d bytes)\n", 
-           current_pid, sender_pid, max_size);
+    if (!data || size <= 0 || size > MAX_MESSAGE_SIZE) {
+        printk("[ipc] ERROR: Invalid multicast payload: %d bytes\n", size);
+        return -1;
+    }
     
-    if (!buffer) {
-        printk("[ipc] ERROR: Null buffer pointer in recv_message\n");
+    for (int i = 0; i < count; i++) {
+        if (check_receiver(receivers[i]) < 0) {
+            return -1;
+        }
+    }
+    
+    struct message *shared = alloc_message(size);
+    if (!shared) {
+        printk("[ipc] ERROR: Failed to allocate multicast message from PID %d\n", current_task);
         return -1;
     }
     
-    if (max_size <= 0) {
-        printk("[ipc] ERROR: Invalid buffer size: %d bytes\n", max_size);
+    shared->sender_pid = current_task;
+    shared->receiver_pid = -1;
+    shared->size = size;
+    multicast_bodies++;
+    
+    const char *src = (const char *)data;
+    for (int i = 0; i < size; i++) {
+        shared->data[i] = src[i];
+    }
+    
+    // The sender holds a reference while fanning out and drops it last
+    int sent = 0;
+    for (int i = 0; i < count; i++) {
+        int receiver_pid = receivers[i];
+        struct msg_queue *queue = &message_queues[receiver_pid];
+        
+        if (!credit_available(receiver_pid, queue)) {
+            queue->throttled++;
+            trace_event(TRACE_IPC_THROTTLE, current_task, receiver_pid, 0, queue->count);
+            continue;
+        }
+        
+        struct message *desc = alloc_message(0);
+        if (!desc) {
+            printk("[ipc] ERROR: Failed to allocate multicast descriptor for PID %d\n", 
+                   receiver_pid);
+            continue;
+        }
+        
+        desc->size = size;
+        desc->payload = shared;
+        shared->refs++;
+        
+        post_message(receiver_pid, queue, desc);
+        sent++;
+    }
+    
+    trace_event(TRACE_IPC_MCAST, current_task, -1, size, sent);
+    
+    put_message(shared);
+    return sent;
+}
+
+// Check the arguments common to every receive variant
+static int check_recv_args(int sender_pid) {
+    if (current_task < 0 || current_task >= MAX_TASKS) {
+        printk("[ipc] ERROR: Invalid current task PID: %d\n", current_task);
         return -1;
     }
     
-    if (current_pid < 0 || current_pid >= MAX_TASKS) {
-        printk("[ipc] ERROR: Invalid current task PID: %d\n", current_pid);
+    if (sender_pid < -1 || sender_pid >= MAX_TASKS) {
+        printk("[ipc] ERROR: Invalid sender PID %d in recv_message\n", sender_pid);
         return -1;
     }
     
+    return 0;
+}
+
+// Notification bits are posted without the kernel lock (from interrupt
+// handlers, timer callbacks and other harts), so blocking waits re-check
+// them once marked blocked; see task_block_unless()
+static int recv_notified(void) {
+    struct task *self = &tasks[current_task];
+    return (self->notify_pending & self->notify_mask) != 0;
+}
+
+static int notify_ready(void) {
+    struct task *self = &tasks[current_task];
+    return (self->notify_pending & self->notify_wait_mask) != 0;
+}
+
+// Dequeue a message from sender_pid, blocking for up to timeout_ms while none
+// is queued. Returns 0 with *status set (-1 or IPC_NOTIFIED) if none arrives,
+// and IPC_NOTIFIED whenever masked notification bits are pending, even with
+// messages queued: the caller consumes the bits and comes back for them.
+static struct message *wait_for_message(int sender_pid, int timeout_ms, int *status) {
+    int current_pid = current_task;
     struct msg_queue *queue = &message_queues[current_pid];
+    struct task *self = &tasks[current_pid];
     
-    if (!queue->head) {
-        // No messages available - in a real system, we'd block here
-        printk("[ipc] No messages available for PID %d (queue empty)\n", current_pid);
-        return -1;
+    unsigned long deadline = 0;
+    if (timeout_ms > 0) {
+        deadline = timer_now() + MS_TO_TIMER_TICKS(timeout_ms);
     }
     
-    struct message *msg = queue->head;
-    queue->head = msg->next;
-    if (!queue->head) {
-        queue->tail = 0;
+    struct message *msg;
+    while (1) {
+        // Pending notifications the task opted into end the wait. Checked
+        // ahead of the queue, so a steady message stream cannot starve them.
+        if (__atomic_load_n(&self->notify_pending, __ATOMIC_ACQUIRE) & self->notify_mask) {
+            *status = IPC_NOTIFIED;
+            return 0;
+        }
+        
+        msg = dequeue_message(queue, sender_pid);
+        if (msg) break;
+        
+        if (timeout_ms == IPC_NO_WAIT) {
+            trace_event(TRACE_IPC_EMPTY, sender_pid, current_pid, 0, 0);
+            *status = -1;
+            return 0;
+        }
+        
+        if (deadline && timer_now() >= deadline) {
+            trace_event(TRACE_IPC_TIMEOUT, sender_pid, current_pid, 0, 0);
+            *status = -1;
+            return 0;
+        }
+        
+        // Sleep until send_message() wakes us or the deadline passes
+        trace_event(TRACE_IPC_BLOCK, sender_pid, current_pid, 0, 0);
+        queue->recv_from = sender_pid;
+        
+        // Waiting on one sender, typically for its reply to our request:
+        // it runs at our priority until it sends. If it is blocked on our
+        // full queue, let it through; see credit_available().
+        if (sender_pid >= 0) {
+            struct task *sender = &tasks[sender_pid];
+            if (sender->credit_wait_on == current_pid &&
+                sender->next_credit_waiter != IPC_CREDIT_GRANTED) {
+                pi_release(sender_pid);
+                task_wakeup(sender_pid, WAIT_SEND);
+            }
+            pi_wait_on(sender_pid);
+        }
+        task_block_unless(WAIT_RECV, deadline, recv_notified);
+        queue->recv_from = -1;
+        pi_release(current_pid);
     }
-    queue->count--;
     
+    return msg;
+}
+
+// Copy a dequeued message to the caller's buffer and release it.
+// Returns the full message size (which may exceed max_size).
+static int deliver_message(struct message *msg, void *buffer, int max_size) {
     // Validate message integrity
     if (msg->sender_pid < 0 || msg->sender_pid >= MAX_TASKS) {
         printk("[ipc] WARNING: Message with invalid sender PID: %d\n", msg->sender_pid);
     }
     
+    // Multicast descriptors carry no data of their own
+    struct message *body = msg->payload;
+    
     if (msg->size <= 0 || msg->size > MAX_MESSAGE_SIZE) {
         printk("[ipc] WARNING: Message with invalid size: %d bytes\n", msg->size);
+        if (body != msg) put_message(body);
         free_message(msg);
         return -1;
     }
     
     // Copy data to buffer
     int copy_size = (msg->size < max_size) ? msg->size : max_size;
-    char *src = msg->data;
+    char *src = body->data;
     char *dst = (char *)buffer;
     for (int i = 0; i < copy_size; i++) {
         dst[i] = src[i];
@@ -240,47 +774,403 @@ int recv_message(int sender_pid, void *buffer, int max_size) {
                copy_size, actual_size);
     }
     
-    printk("[ipc] Message received: PID %d <- PID %d (%d bytes), remaining queue: %d\n", 
-           current_pid, sender, copy_size, queue->count);
+    trace_event(TRACE_IPC_RECV, sender, current_task, copy_size, 
+                message_queues[current_task].count);
+    account_recv(actual_size);
     
-    // Log queue state changes
-    if (queue->count == 0) {
-        printk("[ipc] Queue empty: PID %d has processed all pending messages\n", current_pid);
-    } else if (queue->count < 5 && queue->count > 0) {
-        printk("[ipc] Queue draining: PID %d has %d messages remaining\n", 
-               current_pid, queue->count);
+    if (body != msg) {
+        put_message(body);
     }
-    
     free_message(msg);
     
     return actual_size;
 }
 
+int recv_message(int sender_pid, void *buffer, int max_size) {
+    return recv_message_timeout(sender_pid, buffer, max_size, IPC_WAIT_FOREVER);
+}
+
+// Receive a message from sender_pid (-1 = any sender), blocking for up to
+// timeout_ms while none is queued. IPC_NO_WAIT polls once, IPC_WAIT_FOREVER
+// blocks until a matching message arrives.
+int recv_message_timeout(int sender_pid, void *buffer, int max_size, int timeout_ms) {
+    if (!buffer) {
+        printk("[ipc] ERROR: Null buffer pointer in recv_message\n");
+        return -1;
+    }
+    
+    if (max_size <= 0) {
+        printk("[ipc] ERROR: Invalid buffer size: %d bytes\n", max_size);
+        return -1;
+    }
+    
+    if (check_recv_args(sender_pid) < 0) {
+        return -1;
+    }
+    
+    int status;
+    struct message *msg = wait_for_message(sender_pid, timeout_ms, &status);
+    if (!msg) {
+        return status;
+    }
+    
+    return deliver_message(msg, buffer, max_size);
+}
+
+// Drain up to count messages from sender_pid (-1 = any) in one kernel entry.
+// Blocks like recv_message_timeout() until the first message arrives, then
+// takes whatever else is already queued. Each entry gets the sender and full
+// size of its message. Returns the number of entries filled, or -1/IPC_NOTIFIED.
+int recv_message_vector(int sender_pid, struct ipc_recv_entry *entries, int count, 
+                        int timeout_ms) {
+    if (!entries || count <= 0 || count > IPC_MAX_BATCH) {
+        printk("[ipc] ERROR: Invalid receive vector\n");
+        return -1;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        if (!entries[i].buffer || entries[i].max_size <= 0) {
+            printk("[ipc] ERROR: Invalid buffer in receive vector entry %d\n", i);
+            return -1;
+        }
+    }
+    
+    if (check_recv_args(sender_pid) < 0) {
+        return -1;
+    }
+    
+    int status;
+    struct message *msg = wait_for_message(sender_pid, timeout_ms, &status);
+    if (!msg) {
+        return status;
+    }
+    
+    struct msg_queue *queue = &message_queues[current_task];
+    int received = 0;
+    while (msg) {
+        struct ipc_recv_entry *entry = &entries[received];
+        entry->sender_pid = msg->sender_pid;
+        entry->size = deliver_message(msg, entry->buffer, entry->max_size);
+        
+        if (++received == count) break;
+        msg = dequeue_message(queue, sender_pid);
+    }
+    
+    return received;
+}
+
 int try_recv_message(int sender_pid, void *buffer, int max_size) {
     // Non-blocking version of recv_message
-    printk("[ipc] Non-blocking receive attempt: PID %d\n", current_task);
-    int result = recv_message(sender_pid, buffer, max_size);
+    return recv_message_timeout(sender_pid, buffer, max_size, IPC_NO_WAIT);
+}
+
+// Set notification bits on pid. Safe from interrupt handlers: no allocation,
+// one atomic OR, and it cannot fail for lack of message slots.
+int notify_signal(int pid, unsigned long bits) {
+    if (pid < 0 || pid >= num_tasks || tasks[pid].state == TASK_UNUSED) {
+        return -1;
+    }
+    
+    struct task *task = &tasks[pid];
+    unsigned long pending = __atomic_or_fetch(&task->notify_pending, bits, __ATOMIC_SEQ_CST);
+    
+    if (pending & task->notify_mask) {
+        task_wakeup(pid, WAIT_RECV);
+    }
+    if (pending & task->notify_wait_mask) {
+        task_wakeup(pid, WAIT_NOTIFY);
+    }
+    
+    return 0;
+}
+
+// Wait until any bit in mask is pending, then clear and return those bits.
+// Returns 0 on timeout; IPC_NO_WAIT just polls.
+unsigned long notify_wait(unsigned long mask, int timeout_ms) {
+    struct task *task = &tasks[current_task];
+    
+    unsigned long deadline = 0;
+    if (timeout_ms > 0) {
+        deadline = timer_now() + MS_TO_TIMER_TICKS(timeout_ms);
+    }
+    
+    while (!(task->notify_pending & mask)) {
+        if (timeout_ms == IPC_NO_WAIT || (deadline && timer_now() >= deadline)) {
+            return 0;
+        }
+        
+        task->notify_wait_mask = mask;
+        task_block_unless(WAIT_NOTIFY, deadline, notify_ready);
+        task->notify_wait_mask = 0;
+    }
+    
+    return __atomic_fetch_and(&task->notify_pending, ~mask, __ATOMIC_SEQ_CST) & mask;
+}
+
+// Choose which notification bits also wake a blocking receive (which then
+// returns IPC_NOTIFIED). Returns the previous mask.
+unsigned long notify_set_mask(unsigned long mask) {
+    struct task *task = &tasks[current_task];
+    unsigned long old = task->notify_mask;
+    task->notify_mask = mask;
+    return old;
+}
+
+// Copy the valid words of a register block (at most IPC_FAST_WORDS)
+static void copy_regs(struct ipc_regs *dst, const struct ipc_regs *src) {
+    int count = src->count;
+    if (count < 0) count = 0;
+    if (count > IPC_FAST_WORDS) count = IPC_FAST_WORDS;
+    
+    dst->count = count;
+    for (int i = 0; i < count; i++) {
+        dst->mr[i] = src->mr[i];
+    }
+}
+
+// Synchronous call: pass regs to server_pid, switch straight to it if it is
+// waiting, and block until it replies. The reply overwrites regs.
+int call_message(int server_pid, struct ipc_regs *regs) {
+    if (server_pid < 0 || server_pid >= num_tasks || server_pid == current_task ||
+        tasks[server_pid].state == TASK_UNUSED || !regs) {
+        return -1;
+    }
+    
+    struct task *client = &tasks[current_task];
+    struct task *server = &tasks[server_pid];
+    
+    trace_event(TRACE_IPC_CALL, current_task, server_pid, regs->count, 0);
+    account_send(regs->count * sizeof(unsigned long));
+    
+    // Park the request in our own TCB and join the server's caller queue
+    copy_regs(&client->ipc_regs, regs);
+    client->ipc_partner = server_pid;
+    client->next_caller = -1;
+    if (server->caller_tail < 0) {
+        server->caller_head = server->caller_tail = current_task;
+    } else {
+        tasks[server->caller_tail].next_caller = current_task;
+        server->caller_tail = current_task;
+    }
+    
+    // Until it replies, the server runs at our priority if that is higher
+    pi_wait_on(server_pid);
+    
+    // Direct process switch when the server is already waiting for us
+    if (server->state == TASK_BLOCKED && server->wait_reason == WAIT_CALLER) {
+        task_wakeup(server_pid, WAIT_CALLER);
+        task_block_handoff(WAIT_CALL, server_pid);
+    }
+    
+    while (client->ipc_partner >= 0) {
+        task_block(WAIT_CALL, 0);
+    }
+    pi_release(current_task);
+    
+    if (client->ipc_partner == IPC_SERVER_EXITED) {
+        client->ipc_partner = -1;
+        return -1;
+    }
+    
+    copy_regs(regs, &client->ipc_regs);
+    account_recv(regs->count * sizeof(unsigned long));
+    return 0;
+}
+
+// Server side of the fast path: reply to reply_to (if >= 0), then wait for the
+// next call. Returns the caller's PID with its request in regs.
+int reply_wait_message(int reply_to, struct ipc_regs *regs) {
+    if (!regs) return -1;
+    
+    struct task *server = &tasks[current_task];
+    int handoff = -1;
+    
+    if (reply_to >= 0) {
+        if (reply_to >= num_tasks || tasks[reply_to].ipc_partner != current_task ||
+            tasks[reply_to].next_caller != IPC_CALLER_SERVED) {
+            printk("[ipc] ERROR: PID %d replied to PID %d which it is not serving\n", 
+                   current_task, reply_to);
+            return -1;
+        }
+        
+        struct task *client = &tasks[reply_to];
+        copy_regs(&client->ipc_regs, regs);
+        client->ipc_partner = -1;
+        client->next_caller = -1;
+        pi_release(reply_to);
+        task_wakeup(reply_to, WAIT_CALL);
+        handoff = reply_to;
+        trace_event(TRACE_IPC_REPLY, current_task, reply_to, regs->count, 0);
+        account_send(client->ipc_regs.count * sizeof(unsigned long));
+    }
+    
+    // Wait for a caller, handing the CPU back to the client we just answered
+    while (server->caller_head < 0) {
+        if (handoff >= 0) {
+            task_block_handoff(WAIT_CALLER, handoff);
+            handoff = -1;
+        } else {
+            task_block(WAIT_CALLER, 0);
+        }
+    }
+    
+    int caller = server->caller_head;
+    server->caller_head = tasks[caller].next_caller;
+    if (server->caller_head < 0) {
+        server->caller_tail = -1;
+    }
+    tasks[caller].next_caller = IPC_CALLER_SERVED;
+    
+    copy_regs(regs, &tasks[caller].ipc_regs);
+    account_recv(regs->count * sizeof(unsigned long));
+    return caller;
+}
+
+// Tear down an exiting task's IPC state so whoever reuses its slot starts
+// clean: drop its queued messages, release throttled senders and callers
+// (their sends and calls fail), revoke grants it owns or holds and clear
+// its notifications. Called under the kernel lock.
+void ipc_task_exit(int pid) {
+    struct msg_queue *queue = &message_queues[pid];
+    struct message *msg;
+    
+    // Senders waiting for credit, granted a slot or not, fail their send
+    for (int i = 0; i < num_tasks; i++) {
+        if (tasks[i].credit_wait_on == pid) {
+            tasks[i].credit_wait_on = -1;
+            tasks[i].next_credit_waiter = -1;
+            pi_release(i);
+            task_wakeup(i, WAIT_SEND);
+        }
+    }
+    queue->credit_head = queue->credit_tail = -1;
+    queue->granted = 0;
+    
+    while ((msg = dequeue_message(queue, -1))) {
+        if (msg->payload != msg) {
+            put_message(msg->payload);
+        }
+        free_message(msg);
+    }
+    queue->recv_from = -1;
+    queue->max_depth = IPC_DEFAULT_QUEUE_DEPTH;
+    queue->throttled = 0;
+    
+    // Queued callers and the one being served, if any
+    for (int i = 0; i < num_tasks; i++) {
+        if (tasks[i].ipc_partner == pid) {
+            tasks[i].ipc_partner = IPC_SERVER_EXITED;
+            tasks[i].next_caller = -1;
+            task_wakeup(i, WAIT_CALL);
+        }
+    }
+    
+    struct task *task = &tasks[pid];
+    task->caller_head = task->caller_tail = -1;
+    task->notify_pending = 0;
+    task->notify_mask = 0;
+    task->notify_wait_mask = 0;
+    
+    for (int i = 0; i < MAX_GRANTS; i++) {
+        struct grant *g = &grants[i];
+        if (g->in_use && (g->owner_pid == pid || g->grantee_pid == pid)) {
+            g->in_use = 0;
+            g->generation = (g->generation + 1) & 0x7FFFFF;
+        }
+    }
+}
+
+// Grant handles carry the table index in the low byte and the slot's
+// generation above it, so a handle dies with the grant it named
+#define GRANT_HANDLE(index, gen) (((gen) << 8) | (index))
+#define GRANT_INDEX(handle)      ((handle) & 0xFF)
+#define GRANT_GEN(handle)        ((handle) >> 8)
+
+static struct grant *lookup_grant(int handle) {
+    if (handle < 0) return 0;
+    
+    int index = GRANT_INDEX(handle);
+    if (index >= MAX_GRANTS) return 0;
+    
+    struct grant *g = &grants[index];
+    if (!g->in_use || g->generation != GRANT_GEN(handle)) return 0;
+    
+    return g;
+}
+
+// Expose [base, base + size) to grantee_pid. Returns a handle to pass in a
+// message, or -1 if the table is full or the arguments are invalid.
+int grant_create(int grantee_pid, void *base, int size, int flags) {
+    if (grantee_pid < 0 || grantee_pid >= MAX_TASKS || !base || size <= 0 ||
+        !(flags & (GRANT_READ | GRANT_WRITE))) {
+        printk("[ipc] ERROR: Invalid grant request from PID %d\n", current_task);
+        return -1;
+    }
+    
+    for (int i = 0; i < MAX_GRANTS; i++) {
+        struct grant *g = &grants[i];
+        if (g->in_use) continue;
+        
+        g->owner_pid = current_task;
+        g->grantee_pid = grantee_pid;
+        g->base = base;
+        g->size = size;
+        g->flags = flags;
+        g->in_use = 1;
+        
+        return GRANT_HANDLE(i, g->generation);
+    }
+    
+    printk("[ipc] ERROR: Grant table full (%d grants)\n", MAX_GRANTS);
+    return -1;
+}
+
+// Resolve a grant for the calling task. All tasks share one address space,
+// so "mapping" hands back the owner's buffer and nothing is copied.
+void *grant_map(int handle, int flags, int *size) {
+    struct grant *g = lookup_grant(handle);
+    if (!g) return 0;
     
-    if (result == -1) {
-        printk("[ipc] Non-blocking receive: No messages available for PID %d\n", current_task);
+    if (current_task != g->grantee_pid && current_task != g->owner_pid) {
+        printk("[ipc] ERROR: PID %d may not map grant %d\n", current_task, handle);
+        return 0;
     }
     
-    return result;
+    if ((g->flags & flags) != flags) {
+        printk("[ipc] ERROR: Grant %d does not allow access 0x%x\n", handle, flags);
+        return 0;
+    }
+    
+    if (size) *size = g->size;
+    return g->base;
+}
+
+// Withdraw a grant. Only the owner may revoke it.
+int grant_revoke(int handle) {
+    struct grant *g = lookup_grant(handle);
+    if (!g || g->owner_pid != current_task) return -1;
+    
+    g->in_use = 0;
+    g->generation = (g->generation + 1) & 0x7FFFFF;
+    return 0;
 }
 
 // Debug function to show current IPC status
 void ipc_debug_status(void) {
-    int free_count = count_free_messages();
-    int used_count = MAX_MESSAGES - free_count;
+    int used_count = messages_in_use;
+    int free_count = MAX_MESSAGES - used_count;
     
     printk("[ipc] ========== IPC SYSTEM STATUS ==========\n");
-    printk("[ipc] Memory: %d/%d messages in use, %d free (%.1f%% utilization)\n", 
-           used_count, MAX_MESSAGES, free_count, 
-           (float)(used_count * 100) / MAX_MESSAGES);
+    printk("[ipc] Memory: %d/%d messages in use, %d free\n", 
+           used_count, MAX_MESSAGES, free_count);
     
-    printk("[ipc] Message size: %d bytes each, pool size: %d KB total\n", 
-           (int)sizeof(struct message), 
-           (int)(MAX_MESSAGES * sizeof(struct message)) / 1024);
+    for (int i = 0; i < NUM_MSG_SLABS; i++) {
+        struct msg_slab *slab = &msg_slabs[i];
+        printk("[ipc]   %d-byte slab: %d/%d in use (peak %d, grown %d times, %d KB)\n", 
+               slab->payload_size, slab->total - slab->free, slab->total, 
+               slab->peak_in_use, slab->grows, 
+               (slab->total * slab_object_size(slab)) / 1024);
+    }
     
     // Show queue status for each task
     int total_queued = 0;
@@ -288,9 +1178,10 @@ void ipc_debug_status(void) {
     
     printk("[ipc] Queue Status:\n");
     for (int i = 0; i < MAX_TASKS; i++) {
-        if (message_queues[i].count > 0) {
-            printk("[ipc]   Task %d: %d messages queued\n", 
-                   i, message_queues[i].count);
+        if (message_queues[i].count > 0 || message_queues[i].throttled > 0) {
+            printk("[ipc]   Task %d: %d/%d messages queued, senders throttled %d times\n", 
+                   i, message_queues[i].count, message_queues[i].max_depth, 
+                   message_queues[i].throttled);
             total_queued += message_queues[i].count;
             active_queues++;
         }
@@ -302,9 +1193,11 @@ void ipc_debug_status(void) {
         printk("[ipc] Active queues: %d, Total queued messages: %d\n", 
                active_queues, total_queued);
         
-        if (total_queued != used_count) {
-            printk("[ipc] WARNING: Queue count mismatch! Queued: %d, Used: %d\n", 
-                   total_queued, used_count);
+        // A multicast body is one message in use but sits on no queue:
+        // each receiver queues a descriptor pointing at it
+        if (total_queued + multicast_bodies != used_count) {
+            printk("[ipc] WARNING: Queue count mismatch! Queued: %d, multicast bodies: %d, Used: %d\n", 
+                   total_queued, multicast_bodies, used_count);
         }
     }
     
@@ -356,16 +1249,27 @@ void ipc_log_queue_status(int pid) {
 
 // Log current memory usage in detail
 void ipc_log_memory_usage(void) {
-    int free_count = count_free_messages();
-    int used_count = MAX_MESSAGES - free_count;
+    int used_count = messages_in_use;
+    int free_count = MAX_MESSAGES - used_count;
+    int total_bytes = 0;
+    int used_bytes = 0;
     
     printk("[ipc] Memory Usage Report:\n");
-    printk("[ipc]   Total slots: %d\n", MAX_MESSAGES);
-    printk("[ipc]   Used slots: %d (%.1f%%)\n", used_count, (float)(used_count * 100) / MAX_MESSAGES);
-    printk("[ipc]   Free slots: %d (%.1f%%)\n", free_count, (float)(free_count * 100) / MAX_MESSAGES);
-    printk("[ipc]   Slot size: %d bytes\n", (int)sizeof(struct message));
-    printk("[ipc]   Total memory: %d KB\n", (int)(MAX_MESSAGES * sizeof(struct message)) / 1024);
-    printk("[ipc]   Used memory: %d KB\n", (int)(used_count * sizeof(struct message)) / 1024);
+    printk("[ipc]   Message limit: %d (%d in use)\n", MAX_MESSAGES, used_count);
+    
+    for (int i = 0; i < NUM_MSG_SLABS; i++) {
+        struct msg_slab *slab = &msg_slabs[i];
+        int in_use = slab->total - slab->free;
+        int object_size = slab_object_size(slab);
+        
+        printk("[ipc]   Slab %d (%d bytes): %d used, %d free, peak %d\n", 
+               i, slab->payload_size, in_use, slab->free, slab->peak_in_use);
+        total_bytes += slab->total * object_size;
+        used_bytes += in_use * object_size;
+    }
+    
+    printk("[ipc]   Total memory: %d KB\n", total_bytes / 1024);
+    printk("[ipc]   Used memory: %d KB\n", used_bytes / 1024);
     
     // Memory pressure analysis
     if (free_count < 5) {
@@ -2,29 +2,123 @@
 #define IPC_H
 
 #define MAX_MESSAGE_SIZE 256
-#define MAX_MESSAGES 64  // Increased from 16 to handle more concurrent messages
+#define MAX_MESSAGES 512   // Upper bound on messages in flight across all slabs
+#define MSG_SLAB_GROW 16   // Messages added to a slab each time it runs dry
 
-// Message structure
+// Flow control: a sender to a queue holding this many messages blocks until
+// the receiver drains it, so one backed-up task cannot empty the global pool
+#define IPC_DEFAULT_QUEUE_DEPTH 32
+
+// A sender blocked for credit gives up after this long, so a receiver that
+// never drains its queue fails the send instead of hanging the sender
+#define IPC_CREDIT_TIMEOUT_MS 1000
+
+// Receive timeouts (in milliseconds)
+#define IPC_NO_WAIT       0
+#define IPC_WAIT_FOREVER -1
+
+// Returned by a receive that ended because masked notification bits are pending
+#define IPC_NOTIFIED     -2
+
+// Number of message registers carried by the call/reply fast path
+#define IPC_FAST_WORDS 4
+
+// Short payload passed through the TCB by call_message()/reply_wait_message()
+// without allocating a struct message
+struct ipc_regs {
+    int count;                        // Valid words in mr[]
+    unsigned long mr[IPC_FAST_WORDS]; // Message registers
+};
+
+// Memory grants: a sender exposes a buffer to one receiver by handle so bulk
+// data is read in place instead of being copied through a struct message
+#define MAX_GRANTS   32
+#define GRANT_READ   0x1
+#define GRANT_WRITE  0x2
+
+struct grant {
+    int owner_pid;
+    int grantee_pid;
+    void *base;
+    int size;
+    int flags;
+    int generation;  // Bumped on revoke so stale handles are rejected
+    int in_use;
+};
+
+// Vectored IPC: one entry per message, each gathered from an iovec
+#define IPC_MAX_IOV   16   // Segments gathered into one message
+#define IPC_MAX_BATCH 64   // Entries per send/receive vector call
+
+struct ipc_iovec {
+    const void *base;
+    int len;
+};
+
+struct ipc_send_entry {
+    int receiver_pid;
+    const struct ipc_iovec *iov;
+    int iov_count;
+    int result;         // Set by the kernel: 0 or -1
+};
+
+struct ipc_recv_entry {
+    void *buffer;
+    int max_size;
+    int sender_pid;     // Set by the kernel
+    int size;           // Set by the kernel: full message size or -1
+};
+
+// Multicast fan-out limit per call
+#define MAX_MULTICAST MAX_TASKS
+
+// Message structure - the payload is sized by the slab it came from.
+// A multicast stores its data once and queues a payload-less descriptor per
+// receiver that points at the shared, reference-counted message.
 struct message {
     int sender_pid;
     int receiver_pid;
     int size;
-    char data[MAX_MESSAGE_SIZE];
-    struct message *next;
+    int size_class;    // Index of the owning slab
+    int refs;          // Descriptors (plus the sender while fanning out) using the data
+    struct message *payload;      // Message holding the data - itself unless a descriptor
+    struct message *next;         // Receiver-wide arrival order
+    struct message *prev;
+    struct message *sender_next;  // Next message from the same sender
+    char data[];
 };
 
-// Message queue for each process
-struct msg_queue {
-    struct message *head;
-    struct message *tail;
-    int count;
+// Per-size-class message pool
+struct msg_slab {
+    int payload_size;           // Payload capacity of each message
+    int initial;                // Messages preallocated by ipc_init()
+    struct message *free_list;
+    int total;                  // Messages owned by this slab
+    int free;                   // Messages on the free list
+    int peak_in_use;
+    int grows;                  // Times the slab was refilled from kmalloc
 };
 
 // IPC operations
 void ipc_init(void);
 int send_message(int receiver_pid, const void *data, int size);
 int recv_message(int sender_pid, void *buffer, int max_size);
+int recv_message_timeout(int sender_pid, void *buffer, int max_size, int timeout_ms);
 int try_recv_message(int sender_pid, void *buffer, int max_size);
+int ipc_set_queue_depth(int depth);
+int send_message_vector(struct ipc_send_entry *entries, int count);
+int multicast_message(const int *receivers, int count, const void *data, int size);
+int recv_message_vector(int sender_pid, struct ipc_recv_entry *entries, int count, 
+                        int timeout_ms);
+int call_message(int server_pid, struct ipc_regs *regs);
+int reply_wait_message(int reply_to, struct ipc_regs *regs);
+int notify_signal(int pid, unsigned long bits);
+void ipc_task_exit(int pid);
+unsigned long notify_wait(unsigned long mask, int timeout_ms);
+unsigned long notify_set_mask(unsigned long mask);
+int grant_create(int grantee_pid, void *base, int size, int flags);
+void *grant_map(int handle, int flags, int *size);
+int grant_revoke(int handle);
 void ipc_debug_status(void); // Debug function to show IPC status
 void ipc_log_queue_status(int pid); // Log status of specific queue
 void ipc_log_memory_usage(void); // Log current memory usage
@@ -0,0 +1,307 @@
+#include "ktimer.h"
+#include "sched.h"
+#include "timer.h"
+#include "printk.h"
+
+// Classic cascading wheel. Time is counted in jiffies of 2^KTIMER_SHIFT
+// mtime ticks; clk is the next jiffy to process. A timer due in fewer than
+// 64 jiffies sits in level 0, slot (jiffy % 64). Level L holds timers due
+// within 64^(L+1) jiffies, one slot per 64^L jiffies, and a slot is
+// cascaded (re-inserted one level down) when clk reaches its start. A
+// bitmap per level finds the next busy slot with one rotate and ctz, so
+// the next event is found without walking empty slots.
+
+#define SLOT_MASK   (KTIMER_SLOTS - 1)
+#define LEVEL_SHIFT(level) ((level) * KTIMER_LEVEL_BITS)
+#define MAX_DELTA   ((1UL << (KTIMER_LEVELS * KTIMER_LEVEL_BITS)) - 1)
+#define NO_JIFFY    (~0UL)
+
+struct timer_wheel {
+    spinlock_t lock;
+    unsigned long clk;
+    unsigned long next_expiry;    // mtime of the next event, read without the lock
+    int count;
+    unsigned long bitmap[KTIMER_LEVELS];
+    struct ktimer *slots[KTIMER_LEVELS][KTIMER_SLOTS];
+};
+
+static struct timer_wheel wheels[MAX_HARTS];
+
+static inline unsigned long to_jiffy(unsigned long mtime) {
+    // Round up so a timer never fires early
+    return (mtime + (1UL << KTIMER_SHIFT) - 1) >> KTIMER_SHIFT;
+}
+
+static inline unsigned long ror64(unsigned long x, int n) {
+    return (x >> n) | (x << ((64 - n) & 63));
+}
+
+static void wheel_insert(struct timer_wheel *wheel, struct ktimer *timer) {
+    unsigned long jiffy = to_jiffy(timer->expires);
+    unsigned long delta = (jiffy > wheel->clk) ? jiffy - wheel->clk : 0;
+    
+    if (delta > MAX_DELTA) {
+        // Beyond the wheel: park in the farthest slot, re-cascaded later
+        delta = MAX_DELTA;
+        jiffy = wheel->clk + delta;
+    }
+    if (jiffy < wheel->clk) jiffy = wheel->clk;
+    
+    int level = 0;
+    while (level < KTIMER_LEVELS - 1 &&
+           delta >= (1UL << LEVEL_SHIFT(level + 1))) {
+        level++;
+    }
+    int slot = (jiffy >> LEVEL_SHIFT(level)) & SLOT_MASK;
+    
+    timer->level = level;
+    timer->slot = slot;
+    timer->wheel = wheel;
+    timer->prev = 0;
+    timer->next = wheel->slots[level][slot];
+    if (timer->next) timer->next->prev = timer;
+    wheel->slots[level][slot] = timer;
+    wheel->bitmap[level] |= 1UL << slot;
+    wheel->count++;
+}
+
+static void wheel_remove(struct timer_wheel *wheel, struct ktimer *timer) {
+    if (timer->prev) {
+        timer->prev->next = timer->next;
+    } else {
+        wheel->slots[timer->level][timer->slot] = timer->next;
+    }
+    if (timer->next) timer->next->prev = timer->prev;
+    if (!wheel->slots[timer->level][timer->slot]) {
+        wheel->bitmap[timer->level] &= ~(1UL << timer->slot);
+    }
+    timer->next = timer->prev = 0;
+    timer->wheel = 0;
+    wheel->count--;
+}
+
+// Jiffy of the next slot to expire or cascade, or NO_JIFFY
+static unsigned long wheel_next_event(struct timer_wheel *wheel) {
+    unsigned long next = NO_JIFFY;
+    
+    for (int level = 0; level < KTIMER_LEVELS; level++) {
+        if (!wheel->bitmap[level]) continue;
+        
+        int shift = LEVEL_SHIFT(level);
+        int pos = (wheel->clk >> shift) & SLOT_MASK;
+        unsigned long busy = ror64(wheel->bitmap[level], pos);
+        unsigned long event;
+        
+        if (level == 0) {
+            event = wheel->clk + __builtin_ctzl(busy);
+        } else {
+            // The current slot is due now only if clk sits on its start;
+            // otherwise it comes round again after a full turn
+            int at_start = (wheel->clk & ((1UL << shift) - 1)) == 0;
+            if ((busy & 1) && at_start) {
+                event = wheel->clk;
+            } else {
+                unsigned long later = busy & ~1UL;
+                int d = later ? __builtin_ctzl(later) : KTIMER_SLOTS;
+                event = ((wheel->clk >> shift) + d) << shift;
+            }
+        }
+        if (event < next) next = event;
+    }
+    return next;
+}
+
+static void update_next_expiry(struct timer_wheel *wheel) {
+    unsigned long jiffy = wheel_next_event(wheel);
+    unsigned long expiry = (jiffy == NO_JIFFY) ? TIMER_NO_DEADLINE : jiffy << KTIMER_SHIFT;
+    __atomic_store_n(&wheel->next_expiry, expiry, __ATOMIC_RELEASE);
+}
+
+// Re-insert every timer of a higher-level slot relative to the current clk
+static void cascade(struct timer_wheel *wheel, int level, int slot) {
+    struct ktimer *timer = wheel->slots[level][slot];
+    
+    wheel->slots[level][slot] = 0;
+    wheel->bitmap[level] &= ~(1UL << slot);
+    
+    while (timer) {
+        struct ktimer *next = timer->next;
+        wheel->count--;
+        wheel_insert(wheel, timer);
+        timer = next;
+    }
+}
+
+void ktimer_wheel_init(int hart) {
+    struct timer_wheel *wheel = &wheels[hart];
+    
+    wheel->lock.locked = 0;
+    wheel->clk = to_jiffy(timer_now());
+    wheel->next_expiry = TIMER_NO_DEADLINE;
+    wheel->count = 0;
+    for (int level = 0; level < KTIMER_LEVELS; level++) {
+        wheel->bitmap[level] = 0;
+        for (int slot = 0; slot < KTIMER_SLOTS; slot++) {
+            wheel->slots[level][slot] = 0;
+        }
+    }
+}
+
+// Safe on a timer that is pending or mid-expiry: a pending timer is taken
+// off its wheel first, and a running callback still finishes (with the
+// fn and arg it was collected with).
+void ktimer_init(struct ktimer *timer, void (*fn)(void *arg), void *arg) {
+    ktimer_cancel(timer);
+    timer->next = timer->prev = 0;
+    timer->expires = 0;
+    timer->fn = fn;
+    timer->arg = arg;
+    timer->level = timer->slot = 0;
+}
+
+// Cancel a pending timer. Returns 1 if it was pending, -1 if it has already
+// been collected for expiry and its callback has not finished (it is not
+// stopped; callbacks must tolerate that), and 0 if it was idle.
+int ktimer_cancel(struct ktimer *timer) {
+    struct timer_wheel *wheel = __atomic_load_n(&timer->wheel, __ATOMIC_ACQUIRE);
+    if (!wheel) wheel = __atomic_load_n(&timer->running, __ATOMIC_ACQUIRE);
+    if (!wheel) return 0;
+    
+    spin_lock(&wheel->lock);
+    int pending = 0;
+    if (timer->wheel == wheel) {
+        wheel_remove(wheel, timer);
+        update_next_expiry(wheel);
+        pending = 1;
+    } else if (timer->running == wheel) {
+        pending = -1;
+    }
+    spin_unlock(&wheel->lock);
+    return pending;
+}
+
+// (Re)arm timer for an mtime deadline on this hart's wheel. If that is
+// now the hart's nearest event, pull its timer interrupt in.
+void ktimer_arm(struct ktimer *timer, unsigned long expires) {
+    ktimer_cancel(timer);
+    
+    irq_push_off();
+    struct timer_wheel *wheel = &wheels[this_cpu()->id];
+    
+    spin_lock(&wheel->lock);
+    if (wheel->count == 0) {
+        // Empty wheel: nothing to process in between, so skip clk ahead
+        unsigned long now = to_jiffy(timer_now());
+        if (now > wheel->clk) wheel->clk = now;
+    }
+    timer->expires = expires;
+    wheel_insert(wheel, timer);
+    update_next_expiry(wheel);
+    unsigned long next = wheel->next_expiry;
+    spin_unlock(&wheel->lock);
+    
+    if (next < this_cpu()->timer_deadline) {
+        timer_set_deadline(next);
+    }
+    irq_pop_off();
+}
+
+int ktimer_pending(struct ktimer *timer) {
+    return __atomic_load_n(&timer->wheel, __ATOMIC_ACQUIRE) != 0;
+}
+
+// mtime of this hart's next timer event, TIMER_NO_DEADLINE if none
+unsigned long ktimer_next_expiry(void) {
+    return __atomic_load_n(&wheels[this_cpu()->id].next_expiry, __ATOMIC_ACQUIRE);
+}
+
+// Expire this hart's due timers, one at a time: each is unlinked under the
+// wheel lock and its callback run with the lock dropped, so a callback (or
+// another hart) may arm, init or cancel any timer, this one included.
+// Timers armed while the run is in progress count against a budget of the
+// timers present at entry, so a callback re-arming itself in the past
+// cannot keep the run going; the leftovers fire on the next interrupt.
+void ktimer_run(void) {
+    irq_push_off();
+    struct timer_wheel *wheel = &wheels[this_cpu()->id];
+    unsigned long now = timer_now();
+    
+    if (now < __atomic_load_n(&wheel->next_expiry, __ATOMIC_ACQUIRE)) {
+        irq_pop_off();
+        return;
+    }
+    
+    unsigned long target = now >> KTIMER_SHIFT;
+    unsigned long cascaded = NO_JIFFY;
+    
+    spin_lock(&wheel->lock);
+    int budget = wheel->count;
+    while (wheel->clk <= target && budget > 0) {
+        if (wheel->clk != cascaded) {
+            // Jump over jiffies with nothing to expire or cascade
+            unsigned long event = wheel_next_event(wheel);
+            if (event > target) {
+                wheel->clk = target + 1;
+                break;
+            }
+            if (event > wheel->clk) wheel->clk = event;
+            
+            for (int level = 1; level < KTIMER_LEVELS; level++) {
+                if (wheel->clk & ((1UL << LEVEL_SHIFT(level)) - 1)) break;
+                cascade(wheel, level, (wheel->clk >> LEVEL_SHIFT(level)) & SLOT_MASK);
+            }
+            cascaded = wheel->clk;
+        }
+        
+        struct ktimer *timer = wheel->slots[0][wheel->clk & SLOT_MASK];
+        if (!timer) {
+            wheel->clk++;
+            continue;
+        }
+        wheel_remove(wheel, timer);
+        timer->running = wheel;
+        void (*fn)(void *arg) = timer->fn;
+        void *arg = timer->arg;
+        budget--;
+        update_next_expiry(wheel);
+        spin_unlock(&wheel->lock);
+        irq_pop_off();
+        
+        fn(arg);
+        
+        irq_push_off();
+        spin_lock(&wheel->lock);
+        if (timer->running == wheel) timer->running = 0;
+    }
+    update_next_expiry(wheel);
+    spin_unlock(&wheel->lock);
+    irq_pop_off();
+}
+
+// User timers: each task owns TASK_TIMERS slots. On expiry the timer posts
+// its bits with notify_signal(), so a server can wait for timeouts (e.g.
+// retransmissions) in the same receive loop as its messages.
+static void user_timer_fire(void *arg) {
+    struct user_timer *ut = arg;
+    notify_signal(ut->pid, ut->bits);
+}
+
+int ktimer_user_arm(int id, unsigned long deadline, unsigned long bits) {
+    if (id < 0 || id >= TASK_TIMERS || bits == 0) {
+        printk("[ktimer] Invalid user timer %d (bits 0x%lx)\n", id, bits);
+        return -1;
+    }
+    
+    struct user_timer *ut = &tasks[current_task].timers[id];
+    ktimer_cancel(&ut->timer);
+    ut->pid = current_task;
+    ut->bits = bits;
+    ktimer_init(&ut->timer, user_timer_fire, ut);
+    ktimer_arm(&ut->timer, deadline);
+    return 0;
+}
+
+int ktimer_user_cancel(int id) {
+    if (id < 0 || id >= TASK_TIMERS) return -1;
+    return ktimer_cancel(&tasks[current_task].timers[id].timer);
+}
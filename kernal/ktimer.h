@@ -0,0 +1,48 @@
+#ifndef KTIMER_H
+#define KTIMER_H
+
+// Kernel timers on a per-hart hierarchical timing wheel. Arm and cancel are
+// O(1); expiry is driven by the hart's mtime deadline (see program_timer()
+// in sched.c). Callbacks run on the hart that armed the timer, from the
+// timer interrupt or the scheduler, with no locks held: they must not block.
+
+#define KTIMER_LEVELS     4
+#define KTIMER_LEVEL_BITS 6
+#define KTIMER_SLOTS      (1 << KTIMER_LEVEL_BITS)
+#define KTIMER_SHIFT      10   // Wheel resolution: 1024 mtime ticks (~102us)
+
+#define TASK_TIMERS 4          // User timers per task (SYS_TIMER_ARM)
+
+struct timer_wheel;
+
+struct ktimer {
+    struct ktimer *next, *prev;   // Slot list
+    unsigned long expires;        // mtime deadline
+    void (*fn)(void *arg);
+    void *arg;
+    struct timer_wheel *wheel;    // Wheel holding the timer, 0 when idle
+    struct timer_wheel *running;  // Wheel running its callback, 0 otherwise
+    unsigned char level, slot;
+};
+
+struct user_timer {
+    struct ktimer timer;
+    int pid;
+    unsigned long bits;           // Notification bits posted on expiry
+};
+
+void ktimer_init(struct ktimer *timer, void (*fn)(void *arg), void *arg);
+void ktimer_arm(struct ktimer *timer, unsigned long expires);
+int ktimer_cancel(struct ktimer *timer);
+int ktimer_pending(struct ktimer *timer);
+
+// Per-hart wheel management, called on the hart itself
+void ktimer_wheel_init(int hart);
+void ktimer_run(void);
+unsigned long ktimer_next_expiry(void);
+
+// Task-facing timers: on expiry, post bits to the owning task
+int ktimer_user_arm(int id, unsigned long deadline, unsigned long bits);
+int ktimer_user_cancel(int id);
+
+#endif
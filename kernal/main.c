@@ -6,8 +6,24 @@
 #include "net_driver.h"
 #include "timer.h"
 #include "syscall.h"
+#include "trace.h"
 
-void kmain(void) {
+#ifdef BENCH_IPC
+// SiFive test finisher on QEMU virt - writing FINISHER_PASS powers off
+#define QEMU_TEST_FINISHER 0x100000UL
+#define FINISHER_PASS      0x5555
+
+static void qemu_poweroff(void) {
+    *(volatile unsigned int *)QEMU_TEST_FINISHER = FINISHER_PASS;
+    while (1);
+}
+#endif
+
+void kmain(unsigned long hartid) {
+    // Per-hart state first: everything below may use current_task
+    boot_hart = (int)hartid;
+    cpu_init(boot_hart, 0);
+    
     uart_init();
     printk("\n==============================\n");
     printk(" Amoeba Microkernel (RISC-V)  \n");
@@ -23,13 +39,22 @@ void kmain(void) {
     printk("[main] Starting scheduler...\n");
     sched_init();
     
+    printk("[main] Starting secondary harts...\n");
+    smp_init();
+    
     printk("[main] Starting timer...\n");
-    // Timer requires interrupts - keep disabled until trap vectors work
-    // timer_init();
-    printk("[main] Timer disabled until trap vectors are stable\n");
+    timer_init();
     
     printk("[main] Starting network...\n");
     net_init();
+
+#ifdef BENCH_IPC
+    // Benchmark build: skip servers and tests so the suite owns the task slots
+    printk("[main] Running IPC benchmark suite...\n");
+    extern void ipc_bench_run(void);
+    ipc_bench_run();
+    qemu_poweroff();
+#endif
     
     printk("[main] Starting server processes...\n");
     // Create server processes
@@ -53,11 +78,10 @@ void kmain(void) {
     
     printk("[main] All subsystems initialized\n");
     
-    // Enable interrupts only after everything is set up
+    // Enable interrupts only after everything is set up; from here on the
+    // timer preempts CPU-bound tasks
     printk("[main] Enabling interrupts...\n");
-    // Interrupts disabled until trap vectors work
-    // enable_interrupts();
-    printk("[main] Interrupts disabled until trap vectors are stable\n");
+    enable_interrupts();
     
     printk("[main] Entering main loop...\n");
     
@@ -94,9 +118,8 @@ void kmain(void) {
                 printk("  Bullet server response: %ld\n", result);
             } else if (c == 't') {
                 printk("\n[main] Testing network server...\n");
-                extern long handle_syscall(long, long, long, long, long);
-                long sock = handle_syscall(1, 1, 1, 0, 0); // create TCP socket
-                printk("  Network server socket: %ld\n", sock);
+                extern void server_demo(void);
+                server_demo(); // Sockets, grants and the submission/completion ring
             } else if (c == 'l') {
                 printk("\n[main] Running Phase 5 library tests...\n");
                 extern void phase5_test(void);
@@ -105,16 +128,34 @@ void kmain(void) {
                 printk("\n[main] Running Phase 6 applications demo...\n");
                 extern void phase6_demo(void);
                 phase6_demo();
+            } else if (c == 'p') {
+                printk("\n[main] Running IPC ping-pong benchmark...\n");
+                extern void ipc_pingpong_bench(void);
+                ipc_pingpong_bench();
+            } else if (c == 'B') {
+                printk("\n[main] Running IPC benchmark suite...\n");
+                extern void ipc_bench_run(void);
+                ipc_bench_run();
+            } else if (c == 'w') {
+                printk("\n[main] Running work-stealing benchmark...\n");
+                extern void steal_bench(void);
+                steal_bench();
+                sched_stats();
+            } else if (c == 'T') {
+                printk("\n[main] Task CPU and IPC usage:\n");
+                sched_top();
+                sched_stats();
+            } else if (c == 'i') {
+                printk("\n[main] IPC trace and pool status:\n");
+                trace_dump();
+                ipc_debug_status();
             } else {
-                printk("\n[main] Commands: 'n'=send, 's'=stats, 'r'=RX, 'b'=bullet test, 't'=net test, 'l'=lib test, '6'=Phase 6 apps\n");
+                printk("\n[main] Commands: 'n'=send, 's'=stats, 'r'=RX, 'b'=bullet test, 't'=net test, 'l'=lib test, '6'=Phase 6 apps, 'p'=IPC ping-pong, 'B'=IPC bench, 'w'=work stealing, 'T'=task top, 'i'=IPC trace\n");
                 printk("[main] Received char: %c, Timer ticks: %lu\n", c, get_timer_ticks());
             }
         }
         
-        // Small delay to prevent busy waiting
-        for (volatile int i = 0; i < 1000; i++);
-        
-        // Yield to allow task switching
-        task_yield();
+        // Sleep until the next key; the hart idles if nothing else runs
+        uart_wait_input();
     }
 }
@@ -1,11 +1,166 @@
 #include "mm.h"
 #include "printk.h"
+#include "spinlock.h"
 
-// Heap management
-static struct mem_block *heap_head = 0;
+// Heap management. Blocks tile [heap_start, heap_end) and carry boundary
+// tags; free ones sit in the segregated free index, whose bitmaps point
+// allocation straight at a non-empty list of large enough blocks.
 static char *heap_start;
 static char *heap_end;
 static unsigned int total_allocated = 0;
+static spinlock_t heap_lock = SPINLOCK_INIT;
+
+static struct mem_block *free_lists[HEAP_FL_COUNT][HEAP_SL_COUNT];
+static unsigned int fl_bitmap;
+static unsigned int sl_bitmap[HEAP_FL_COUNT];
+
+#define BLOCK_FOOTER   sizeof(unsigned long)
+#define BLOCK_OVERHEAD (sizeof(struct mem_block) + BLOCK_FOOTER)
+#define BLOCK_MIN_SIZE 16   // Smallest payload split off as a free block
+
+// A slab is one SLAB_PAGE_SIZE page: this header, then per_slab objects.
+// Pages are aligned, so an object's slab is found by masking its address.
+// The free map has a bit per object, enough for the smallest 8-byte ones,
+// so a free of an object that is already free is caught on the spot.
+#define SLAB_MAP_BITS  (8 * sizeof(unsigned long))
+#define SLAB_MAX_OBJS  (SLAB_PAGE_SIZE / 8)
+#define SLAB_MAP_WORDS (SLAB_MAX_OBJS / SLAB_MAP_BITS)
+
+struct slab {
+    struct kmem_cache *cache;
+    struct slab *next, *prev;   // Cache's list of slabs with a free object
+    void *free;                 // Free objects, linked through their first word
+    unsigned int in_use;
+    unsigned long free_map[SLAB_MAP_WORDS];  // Set bit = object is free
+};
+
+#define SLAB_HEADER_SIZE ((sizeof(struct slab) + 15) & ~15UL)
+
+struct kmem_cache {
+    const char *name;
+    unsigned int object_size;
+    unsigned int per_slab;
+    spinlock_t lock;
+    struct slab *partial;       // Slabs with room; full ones are off the list
+    int slabs;                  // Pages held
+    int in_use;
+    int peak_in_use;
+};
+
+static struct kmem_cache caches[KMEM_MAX_CACHES];
+static int num_caches = 0;
+static spinlock_t cache_table_lock = SPINLOCK_INIT;
+
+static struct kmem_cache *kmalloc_caches[KMALLOC_SLAB_CLASSES];
+static const char *kmalloc_names[KMALLOC_SLAB_CLASSES] = {
+    "kmalloc-16", "kmalloc-32", "kmalloc-64", "kmalloc-128", 
+    "kmalloc-256", "kmalloc-512", "kmalloc-1024"
+};
+
+// Slab pages: bump-allocated from the region, and recycled through a free
+// list once a cache gives an empty slab back
+static struct {
+    spinlock_t lock;
+    char *next, *end;
+    void *free;                 // First word of a free page links the next
+    int in_use;
+} slab_pages = { .lock = SPINLOCK_INIT };
+
+// Stack pool. Stacks never come from the kmalloc heap, so an overflow hits
+// a guard word (or the stack below) rather than a heap header, and freed
+// stacks are kept per size class for the next task instead of fragmenting
+// the heap. Fresh stacks are bump-allocated from the region; once it is
+// used up a larger free stack is split.
+static struct {
+    spinlock_t lock;
+    char *next, *end;
+    void *free[STACK_CLASSES];   // First word of a free stack links the next
+    int in_use;
+    unsigned int bytes_in_use;
+} stack_pool = { .lock = SPINLOCK_INIT };
+
+static unsigned long *block_footer(struct mem_block *block) {
+    return (unsigned long *)((char *)block + sizeof(struct mem_block) + block->size);
+}
+
+static struct mem_block *next_block(struct mem_block *block) {
+    char *next = (char *)block + BLOCK_OVERHEAD + block->size;
+    return (next < heap_end) ? (struct mem_block *)next : 0;
+}
+
+// The previous block's footer sits right below this block's header
+static struct mem_block *prev_block(struct mem_block *block) {
+    if ((char *)block <= heap_start) return 0;
+    unsigned long prev_size = *((unsigned long *)block - 1);
+    return (struct mem_block *)((char *)block - BLOCK_OVERHEAD - prev_size);
+}
+
+// Size class of a free block of size bytes
+static void heap_mapping(unsigned int size, int *fl, int *sl) {
+    if (size < HEAP_SMALL_BLOCK) {
+        *fl = 0;
+        *sl = size / (HEAP_SMALL_BLOCK / HEAP_SL_COUNT);
+    } else {
+        int log2 = 31 - __builtin_clz(size);
+        *sl = (size >> (log2 - HEAP_SL_LOG2)) ^ HEAP_SL_COUNT;
+        *fl = log2 - HEAP_FL_SHIFT + 1;
+    }
+}
+
+static void heap_insert(struct mem_block *block) {
+    int fl, sl;
+    heap_mapping(block->size, &fl, &sl);
+    
+    block->free = 1;
+    *block_footer(block) = block->size;
+    block->prev_free = 0;
+    block->next_free = free_lists[fl][sl];
+    if (block->next_free) block->next_free->prev_free = block;
+    free_lists[fl][sl] = block;
+    fl_bitmap |= 1U << fl;
+    sl_bitmap[fl] |= 1U << sl;
+}
+
+static void heap_remove(struct mem_block *block) {
+    int fl, sl;
+    heap_mapping(block->size, &fl, &sl);
+    
+    if (block->prev_free) {
+        block->prev_free->next_free = block->next_free;
+    } else {
+        free_lists[fl][sl] = block->next_free;
+        if (!free_lists[fl][sl]) {
+            sl_bitmap[fl] &= ~(1U << sl);
+            if (!sl_bitmap[fl]) fl_bitmap &= ~(1U << fl);
+        }
+    }
+    if (block->next_free) block->next_free->prev_free = block->prev_free;
+    block->next_free = block->prev_free = 0;
+    block->free = 0;
+}
+
+// A free block of at least size bytes, or 0. The request is rounded up to
+// the next subclass boundary first, so any block on the list found is big
+// enough: two bitmap scans and no list walk (good fit, not best fit).
+static struct mem_block *heap_find(unsigned int size) {
+    if (size > (unsigned long)(heap_end - heap_start)) return 0;
+    if (size >= HEAP_SMALL_BLOCK) {
+        size += (1U << (31 - __builtin_clz(size) - HEAP_SL_LOG2)) - 1;
+    }
+    
+    int fl, sl;
+    heap_mapping(size, &fl, &sl);
+    if (fl >= HEAP_FL_COUNT) return 0;
+    
+    unsigned int sl_map = sl_bitmap[fl] & (~0U << sl);
+    if (!sl_map) {
+        unsigned int fl_map = fl_bitmap & (~0U << (fl + 1));
+        if (!fl_map) return 0;
+        fl = __builtin_ctz(fl_map);
+        sl_map = sl_bitmap[fl];
+    }
+    return free_lists[fl][__builtin_ctz(sl_map)];
+}
 
 void mm_init(void) {
     // Use linker script symbols to determine heap bounds
@@ -20,89 +175,414 @@ void mm_init(void) {
            (unsigned long)heap_end,
            (int)(heap_end - heap_start) / 1024);
     
-    // Initialize first free block
-    heap_head = (struct mem_block *)heap_start;
-    heap_head->size = heap_end - heap_start - sizeof(struct mem_block);
-    heap_head->free = 1;
-    heap_head->next = 0;
+    // The whole heap starts out as one free block
+    struct mem_block *block = (struct mem_block *)heap_start;
+    block->size = (heap_end - heap_start - BLOCK_OVERHEAD) & ~7UL;
+    heap_end = heap_start + block->size + BLOCK_OVERHEAD;
+    heap_insert(block);
+    
+    slab_pages.next = &__slab_start;
+    slab_pages.end = &__slab_end;
+    printk("[mm] Slab pages: 0x%lx - 0x%lx (%d KB)\n", 
+           (unsigned long)slab_pages.next, (unsigned long)slab_pages.end, 
+           (int)(slab_pages.end - slab_pages.next) / 1024);
+    
+    for (int i = 0; i < KMALLOC_SLAB_CLASSES; i++) {
+        kmalloc_caches[i] = kmem_cache_create(kmalloc_names[i], KMALLOC_MIN_SLAB << i);
+    }
+    
+    stack_pool.next = &__stack_pool_start;
+    stack_pool.end = &__stack_pool_end;
+    printk("[mm] Stack pool: 0x%lx - 0x%lx (%d KB)\n", 
+           (unsigned long)stack_pool.next, (unsigned long)stack_pool.end, 
+           (int)(stack_pool.end - stack_pool.next) / 1024);
     
     printk("[mm] Memory manager initialized.\n");
 }
 
-void *kmalloc(unsigned int size) {
-    if (!heap_head) {
-        printk("[mm] Error: heap not initialized\n");
+static int in_slab_region(void *ptr) {
+    return (char *)ptr >= &__slab_start && (char *)ptr < &__slab_end;
+}
+
+static void *slab_page_alloc(void) {
+    void *page = 0;
+    
+    spin_lock(&slab_pages.lock);
+    if (slab_pages.free) {
+        page = slab_pages.free;
+        slab_pages.free = *(void **)page;
+    } else if (slab_pages.next + SLAB_PAGE_SIZE <= slab_pages.end) {
+        page = slab_pages.next;
+        slab_pages.next += SLAB_PAGE_SIZE;
+    }
+    if (page) slab_pages.in_use++;
+    spin_unlock(&slab_pages.lock);
+    
+    return page;
+}
+
+static void slab_page_free(void *page) {
+    spin_lock(&slab_pages.lock);
+    *(void **)page = slab_pages.free;
+    slab_pages.free = page;
+    slab_pages.in_use--;
+    spin_unlock(&slab_pages.lock);
+}
+
+static void partial_add(struct kmem_cache *cache, struct slab *slab) {
+    slab->prev = 0;
+    slab->next = cache->partial;
+    if (cache->partial) cache->partial->prev = slab;
+    cache->partial = slab;
+}
+
+static void partial_remove(struct kmem_cache *cache, struct slab *slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        cache->partial = slab->next;
+    }
+    if (slab->next) slab->next->prev = slab->prev;
+    slab->next = slab->prev = 0;
+}
+
+// Create a cache of size-byte objects (at most SLAB_MAX_OBJECT), 8-byte
+// aligned. Caches live for good; there is a fixed table of them.
+struct kmem_cache *kmem_cache_create(const char *name, unsigned int size) {
+    if (size == 0 || size > SLAB_MAX_OBJECT) {
+        printk("[mm] Cannot create cache %s: %d byte objects (max %d)\n", 
+               name, size, SLAB_MAX_OBJECT);
         return 0;
     }
     
-    // Align size to 8 bytes
+    spin_lock(&cache_table_lock);
+    if (num_caches >= KMEM_MAX_CACHES) {
+        spin_unlock(&cache_table_lock);
+        printk("[mm] Cannot create cache %s: cache table full\n", name);
+        return 0;
+    }
+    struct kmem_cache *cache = &caches[num_caches++];
+    spin_unlock(&cache_table_lock);
+    
+    // Room for the free-list link, and aligned for any kernel object
     size = (size + 7) & ~7;
+    if (size < sizeof(void *)) size = sizeof(void *);
+    
+    cache->name = name;
+    cache->object_size = size;
+    cache->per_slab = (SLAB_PAGE_SIZE - SLAB_HEADER_SIZE) / size;
+    if (cache->per_slab > SLAB_MAX_OBJS) cache->per_slab = SLAB_MAX_OBJS;
+    cache->lock.locked = 0;
+    cache->partial = 0;
+    cache->slabs = 0;
+    cache->in_use = cache->peak_in_use = 0;
+    return cache;
+}
+
+static inline char *slab_objects(struct slab *slab) {
+    return (char *)slab + SLAB_HEADER_SIZE;
+}
+
+static inline void slab_map_flip(struct slab *slab, unsigned int index) {
+    slab->free_map[index / SLAB_MAP_BITS] ^= 1UL << (index % SLAB_MAP_BITS);
+}
+
+static inline int slab_map_free(struct slab *slab, unsigned int index) {
+    return (slab->free_map[index / SLAB_MAP_BITS] >> (index % SLAB_MAP_BITS)) & 1;
+}
+
+// Give cache a fresh slab with every object free. Caller holds cache->lock.
+static struct slab *grow_cache(struct kmem_cache *cache) {
+    struct slab *slab = slab_page_alloc();
+    if (!slab) return 0;
     
-    struct mem_block *current = heap_head;
-    struct mem_block *best_fit = 0;
+    slab->cache = cache;
+    slab->in_use = 0;
+    slab->free = 0;
+    for (int i = 0; i < SLAB_MAP_WORDS; i++) {
+        slab->free_map[i] = 0;
+    }
     
-    // First-fit allocation strategy
-    while (current) {
-        if (current->free && current->size >= size) {
-            best_fit = current;
-            break;
+    // Thread the objects so the lowest address is handed out first
+    char *objects = slab_objects(slab);
+    for (int i = cache->per_slab - 1; i >= 0; i--) {
+        void *obj = objects + i * cache->object_size;
+        *(void **)obj = slab->free;
+        slab->free = obj;
+        slab_map_flip(slab, i);
+    }
+    
+    partial_add(cache, slab);
+    cache->slabs++;
+    return slab;
+}
+
+void *kmem_cache_alloc(struct kmem_cache *cache) {
+    if (!cache) return 0;
+    
+    spin_lock(&cache->lock);
+    
+    struct slab *slab = cache->partial;
+    if (!slab) {
+        slab = grow_cache(cache);
+        if (!slab) {
+            spin_unlock(&cache->lock);
+            return 0;
         }
-        current = current->next;
     }
     
-    if (!best_fit) {
+    void *obj = slab->free;
+    slab->free = *(void **)obj;
+    slab->in_use++;
+    slab_map_flip(slab, ((char *)obj - slab_objects(slab)) / cache->object_size);
+    if (!slab->free) {
+        partial_remove(cache, slab);
+    }
+    
+    cache->in_use++;
+    if (cache->in_use > cache->peak_in_use) {
+        cache->peak_in_use = cache->in_use;
+    }
+    
+    spin_unlock(&cache->lock);
+    return obj;
+}
+
+// Return obj to its slab. An emptied slab goes back to the page pool unless
+// it is the cache's only one with room, which is kept against churn.
+// Returns -1, freeing nothing, if obj is not an allocated object of cache.
+int kmem_cache_free(struct kmem_cache *cache, void *obj) {
+    if (!obj) return 0;
+    
+    struct slab *slab = (struct slab *)((unsigned long)obj & ~(SLAB_PAGE_SIZE - 1UL));
+    if (!cache || !in_slab_region(obj)) {
+        printk("[mm] Warning: bad free of slab object 0x%lx\n", (unsigned long)obj);
+        return -1;
+    }
+    
+    spin_lock(&cache->lock);
+    
+    // Under the lock, so another hart freeing into or releasing this slab
+    // cannot change the answer: the page must still belong to cache, obj
+    // must start one of its objects, and that object must be allocated
+    unsigned long offset = (char *)obj - slab_objects(slab);
+    unsigned int index = offset / cache->object_size;
+    if (slab->cache != cache || (char *)obj < slab_objects(slab) ||
+        offset % cache->object_size || index >= cache->per_slab || slab_map_free(slab, index)) {
+        spin_unlock(&cache->lock);
+        printk("[mm] Warning: bad or double free of slab object 0x%lx\n", (unsigned long)obj);
+        return -1;
+    }
+    
+    slab_map_flip(slab, index);
+    if (!slab->free) {
+        partial_add(cache, slab);
+    }
+    *(void **)obj = slab->free;
+    slab->free = obj;
+    slab->in_use--;
+    cache->in_use--;
+    
+    int release = (slab->in_use == 0 && (cache->partial != slab || slab->next));
+    if (release) {
+        partial_remove(cache, slab);
+        cache->slabs--;
+        slab->cache = 0;
+    }
+    
+    spin_unlock(&cache->lock);
+    
+    if (release) {
+        slab_page_free(slab);
+    }
+    return 0;
+}
+
+// Small requests come from the kmalloc-N caches; larger ones, and small
+// ones once the slab region is used up, from the heap
+void *kmalloc(unsigned int size) {
+    if (size <= SLAB_MAX_OBJECT) {
+        int class = 0;
+        while ((KMALLOC_MIN_SLAB << class) < size) {
+            class++;
+        }
+        void *obj = kmem_cache_alloc(kmalloc_caches[class]);
+        if (obj) return obj;
+    }
+    
+    if (!heap_start) {
+        printk("[mm] Error: heap not initialized\n");
+        return 0;
+    }
+    
+    // Align size to 8 bytes
+    size = (size + 7) & ~7;
+    if (size < BLOCK_MIN_SIZE) size = BLOCK_MIN_SIZE;
+    
+    spin_lock(&heap_lock);
+    
+    struct mem_block *block = heap_find(size);
+    if (!block) {
+        spin_unlock(&heap_lock);
         printk("[mm] Out of memory: requested %d bytes\n", size);
         return 0;
     }
+    heap_remove(block);
     
-    // Split block if it's significantly larger than needed
-    if (best_fit->size > size + sizeof(struct mem_block) + 32) {
-        struct mem_block *new_block = (struct mem_block *)
-            ((char *)best_fit + sizeof(struct mem_block) + size);
-        
-        new_block->size = best_fit->size - size - sizeof(struct mem_block);
-        new_block->free = 1;
-        new_block->next = best_fit->next;
+    // Split off the tail if it makes a usable free block
+    if (block->size >= size + BLOCK_OVERHEAD + BLOCK_MIN_SIZE) {
+        struct mem_block *rest = (struct mem_block *)
+            ((char *)block + BLOCK_OVERHEAD + size);
+        rest->size = block->size - size - BLOCK_OVERHEAD;
+        heap_insert(rest);
         
-        best_fit->size = size;
-        best_fit->next = new_block;
+        block->size = size;
     }
     
-    best_fit->free = 0;
-    total_allocated += best_fit->size;
+    *block_footer(block) = block->size;
+    total_allocated += block->size;
     
-    return (char *)best_fit + sizeof(struct mem_block);
+    spin_unlock(&heap_lock);
+    return (char *)block + sizeof(struct mem_block);
 }
 
+// Freeing merges with free physical neighbours, found through the boundary
+// tags, so it is O(1) however full the heap is
 void kfree(void *ptr) {
     if (!ptr) return;
     
+    if (in_slab_region(ptr)) {
+        struct slab *slab = (struct slab *)((unsigned long)ptr & ~(SLAB_PAGE_SIZE - 1UL));
+        kmem_cache_free(slab->cache, ptr);
+        return;
+    }
+    
     struct mem_block *block = (struct mem_block *)((char *)ptr - sizeof(struct mem_block));
+    if ((char *)block < heap_start || (char *)block >= heap_end) {
+        printk("[mm] Warning: free of non-heap pointer 0x%lx\n", (unsigned long)ptr);
+        return;
+    }
+    
+    spin_lock(&heap_lock);
     
     if (block->free) {
+        spin_unlock(&heap_lock);
         printk("[mm] Warning: double free detected\n");
         return;
     }
+    if (*block_footer(block) != block->size) {
+        spin_unlock(&heap_lock);
+        printk("[mm] Warning: heap block at 0x%lx is corrupt\n", (unsigned long)block);
+        return;
+    }
     
-    block->free = 1;
     total_allocated -= block->size;
     
     // Coalesce with next block if it's free
-    if (block->next && block->next->free) {
-        block->size += block->next->size + sizeof(struct mem_block);
-        block->next = block->next->next;
+    struct mem_block *next = next_block(block);
+    if (next && next->free) {
+        heap_remove(next);
+        block->size += next->size + BLOCK_OVERHEAD;
     }
     
     // Coalesce with previous block if it's free
-    struct mem_block *current = heap_head;
-    while (current && current->next != block) {
-        current = current->next;
+    struct mem_block *prev = prev_block(block);
+    if (prev && prev->free) {
+        heap_remove(prev);
+        prev->size += block->size + BLOCK_OVERHEAD;
+        block = prev;
+    }
+    
+    heap_insert(block);
+    spin_unlock(&heap_lock);
+}
+
+static int stack_class(unsigned int size) {
+    int class = 0;
+    while (class < STACK_CLASSES - 1 && (STACK_MIN_SIZE << class) < size) {
+        class++;
+    }
+    return class;
+}
+
+// Allocate a task stack of at least size bytes (at most STACK_MAX_SIZE),
+// with its guard words set. The rounded-up size goes to *actual.
+void *stack_alloc(unsigned int size, unsigned int *actual) {
+    if (size > STACK_MAX_SIZE) {
+        printk("[mm] Stack of %d bytes exceeds the %d byte limit\n", size, STACK_MAX_SIZE);
+        return 0;
+    }
+    
+    int class = stack_class(size);
+    unsigned int class_size = STACK_MIN_SIZE << class;
+    char *base = 0;
+    
+    spin_lock(&stack_pool.lock);
+    
+    if (stack_pool.free[class]) {
+        base = stack_pool.free[class];
+        stack_pool.free[class] = *(void **)base;
+    } else if (stack_pool.next + class_size <= stack_pool.end) {
+        base = stack_pool.next;
+        stack_pool.next += class_size;
+    } else {
+        // Region exhausted: halve a larger free stack down to this size
+        for (int c = class + 1; c < STACK_CLASSES; c++) {
+            if (!stack_pool.free[c]) continue;
+            
+            base = stack_pool.free[c];
+            stack_pool.free[c] = *(void **)base;
+            while (c > class) {
+                c--;
+                void *half = base + (STACK_MIN_SIZE << c);
+                *(void **)half = stack_pool.free[c];
+                stack_pool.free[c] = half;
+            }
+            break;
+        }
+    }
+    
+    if (base) {
+        stack_pool.in_use++;
+        stack_pool.bytes_in_use += class_size;
+    }
+    spin_unlock(&stack_pool.lock);
+    
+    if (!base) {
+        printk("[mm] Stack pool exhausted: requested %d bytes\n", class_size);
+        return 0;
+    }
+    
+    unsigned long *guard = (unsigned long *)base;
+    for (int i = 0; i < STACK_GUARD_WORDS; i++) {
+        guard[i] = STACK_GUARD;
     }
     
-    if (current && current->free) {
-        current->size += block->size + sizeof(struct mem_block);
-        current->next = block->next;
+    if (actual) *actual = class_size;
+    return base;
+}
+
+// Return a stack from stack_alloc(); size is the *actual it reported
+void stack_free(void *base, unsigned int size) {
+    if (!base) return;
+    
+    int class = stack_class(size);
+    
+    spin_lock(&stack_pool.lock);
+    *(void **)base = stack_pool.free[class];
+    stack_pool.free[class] = base;
+    stack_pool.in_use--;
+    stack_pool.bytes_in_use -= STACK_MIN_SIZE << class;
+    spin_unlock(&stack_pool.lock);
+}
+
+// Whether the guard words at the bottom of a stack are untouched
+int stack_intact(void *base) {
+    unsigned long *guard = (unsigned long *)base;
+    for (int i = 0; i < STACK_GUARD_WORDS; i++) {
+        if (guard[i] != STACK_GUARD) return 0;
     }
+    return 1;
 }
 
 void mm_stats(void) {
@@ -110,16 +590,31 @@ void mm_stats(void) {
     int num_blocks = 0;
     int num_free_blocks = 0;
     
-    struct mem_block *current = heap_head;
+    spin_lock(&heap_lock);
+    struct mem_block *current = heap_start ? (struct mem_block *)heap_start : 0;
     while (current) {
         num_blocks++;
         if (current->free) {
             num_free_blocks++;
             total_free += current->size;
         }
-        current = current->next;
+        current = next_block(current);
     }
+    spin_unlock(&heap_lock);
     
     printk("[mm] Stats: %d blocks (%d free), %d bytes allocated, %d bytes free\n",
            num_blocks, num_free_blocks, total_allocated, total_free);
+    printk("[mm] Slabs: %d pages in use, %d KB never used\n", 
+           slab_pages.in_use, (int)(slab_pages.end - slab_pages.next) / 1024);
+    for (int i = 0; i < num_caches; i++) {
+        struct kmem_cache *cache = &caches[i];
+        if (cache->slabs == 0 && cache->peak_in_use == 0) continue;
+        
+        printk("[mm]   %s: %d/%d objects of %d bytes in use (peak %d, %d pages)\n", 
+               cache->name, cache->in_use, cache->slabs * (int)cache->per_slab, 
+               cache->object_size, cache->peak_in_use, cache->slabs);
+    }
+    printk("[mm] Stacks: %d in use (%d KB), %d KB never used\n", 
+           stack_pool.in_use, (int)(stack_pool.bytes_in_use / 1024), 
+           (int)(stack_pool.end - stack_pool.next) / 1024);
 }
@@ -1,23 +1,69 @@
 #ifndef MM_H
 #define MM_H
 
-// Memory block header for tracking allocations
+// Heap block: this header, size bytes of payload, then a footer word
+// repeating size (boundary tags), so both physical neighbours of a block
+// are found in O(1). Free blocks are also linked into the free list of
+// their size class.
 struct mem_block {
     unsigned int size;
     int free;
-    struct mem_block *next;
+    struct mem_block *next_free;  // Only while free
+    struct mem_block *prev_free;
 };
 
+// Free index: HEAP_FL_COUNT power-of-two ranges, each split into
+// HEAP_SL_COUNT linear subclasses (two-level segregated fit, as in TLSF).
+// Sizes below HEAP_SMALL_BLOCK share the first range in 8-byte steps.
+#define HEAP_SL_LOG2     4
+#define HEAP_SL_COUNT    (1 << HEAP_SL_LOG2)
+#define HEAP_FL_SHIFT    (HEAP_SL_LOG2 + 3)
+#define HEAP_SMALL_BLOCK (1U << HEAP_FL_SHIFT)
+#define HEAP_FL_COUNT    (32 - HEAP_FL_SHIFT + 1)
+
 // External symbols from linker script
 extern char __bss_end;
 extern char __heap_start;
 extern char __heap_end;
+extern char __slab_start;
+extern char __slab_end;
+extern char __stack_pool_start;
+extern char __stack_pool_end;
 extern char _stack_top;
 
+// Task stacks: power-of-two sizes from STACK_MIN_SIZE to STACK_MAX_SIZE,
+// carved from a region of their own. The lowest STACK_GUARD_WORDS words
+// hold STACK_GUARD; a task that runs off the bottom overwrites them.
+#define STACK_MIN_SIZE    1024
+#define STACK_MAX_SIZE    16384
+#define STACK_CLASSES     5     // 1K, 2K, 4K, 8K, 16K
+#define STACK_GUARD_WORDS 4
+#define STACK_GUARD       0x5354414b47554152UL
+
+// Slab caches: fixed-size objects packed into SLAB_PAGE_SIZE pages taken
+// from a region of their own, so allocation and free are O(1) and never
+// fragment the heap. kmalloc() serves requests up to SLAB_MAX_OBJECT from
+// power-of-two caches (KMALLOC_MIN_SLAB and up) and only larger ones from
+// the segregated-fit heap above. A free of an object that is not allocated
+// is refused, so a double free cannot corrupt a slab's free list.
+#define SLAB_PAGE_SIZE       4096
+#define SLAB_MAX_OBJECT      1024
+#define KMALLOC_MIN_SLAB     16
+#define KMALLOC_SLAB_CLASSES 7     // 16, 32, ... 1024
+#define KMEM_MAX_CACHES      32
+
+struct kmem_cache;
+
 // Function declarations
 void mm_init(void);
 void *kmalloc(unsigned int size);
 void kfree(void *ptr);
 void mm_stats(void);
+struct kmem_cache *kmem_cache_create(const char *name, unsigned int size);
+void *kmem_cache_alloc(struct kmem_cache *cache);
+int kmem_cache_free(struct kmem_cache *cache, void *obj);
+void *stack_alloc(unsigned int size, unsigned int *actual);
+void stack_free(void *base, unsigned int size);
+int stack_intact(void *base);
 
 #endif // MM_H
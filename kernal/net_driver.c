@@ -1,6 +1,7 @@
 #include "net_driver.h"
 #include "printk.h"
 #include "mm.h"
+#include "ipc.h"
 #include <stddef.h>
 
 // VirtIO-Net device registers (QEMU virt machine)
@@ -32,6 +33,10 @@ static struct net_packet *rx_queue_tail = NULL;
 // Network statistics
 static struct net_stats stats = {0};
 
+// Task notified when packets arrive (-1 = nobody)
+static int rx_notify_pid = -1;
+static unsigned long rx_notify_bits = 0;
+
 // MAC address (will be set by device)
 static uint8_t mac_addr[6];
 
@@ -156,6 +161,12 @@ struct net_stats *net_get_stats(void) {
     return &stats;
 }
 
+// Register a task to be signalled with bits whenever a packet is received
+void net_set_rx_notify(int pid, unsigned long bits) {
+    rx_notify_pid = pid;
+    rx_notify_bits = bits;
+}
+
 void net_interrupt_handler(void) {
     // Handle VirtIO-Net interrupts
     // For now, simulate receiving a packet occasionally
@@ -185,6 +196,10 @@ void net_interrupt_handler(void) {
             stats.rx_bytes += pkt->length;
             
             printk("[net] Simulated packet received (%d bytes)\n", pkt->length);
+            
+            if (rx_notify_pid >= 0) {
+                notify_signal(rx_notify_pid, rx_notify_bits);
+            }
         }
     }
 }
@@ -0,0 +1,38 @@
+#include "plic.h"
+#include "smp.h"
+
+#define PLIC_BASE 0x0C000000UL
+#define PLIC_PRIORITY(irq)      (PLIC_BASE + 4 * (irq))
+#define PLIC_ENABLE(ctx)        (PLIC_BASE + 0x2000 + 0x80 * (ctx))
+#define PLIC_THRESHOLD(ctx)     (PLIC_BASE + 0x200000 + 0x1000 * (ctx))
+#define PLIC_CLAIM(ctx)         (PLIC_BASE + 0x200004 + 0x1000 * (ctx))
+
+// QEMU virt gives each hart an M-mode context (2 * hart) and an S-mode one
+#define PLIC_SCONTEXT(hart) (2 * (hart) + 1)
+
+static inline unsigned int read_reg(unsigned long addr) {
+    return *(volatile unsigned int *)addr;
+}
+
+static inline void write_reg(unsigned long addr, unsigned int value) {
+    *(volatile unsigned int *)addr = value;
+}
+
+// Route irq to hart's supervisor context
+void plic_enable(int irq, int hart) {
+    int ctx = PLIC_SCONTEXT(hart);
+    unsigned long enable = PLIC_ENABLE(ctx) + 4 * (irq / 32);
+    
+    write_reg(PLIC_PRIORITY(irq), 1);
+    write_reg(enable, read_reg(enable) | (1U << (irq % 32)));
+    write_reg(PLIC_THRESHOLD(ctx), 0);
+}
+
+// Highest-priority pending interrupt for this hart, or 0
+int plic_claim(void) {
+    return (int)read_reg(PLIC_CLAIM(PLIC_SCONTEXT(this_cpu()->id)));
+}
+
+void plic_complete(int irq) {
+    write_reg(PLIC_CLAIM(PLIC_SCONTEXT(this_cpu()->id)), (unsigned int)irq);
+}
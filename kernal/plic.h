@@ -0,0 +1,11 @@
+#ifndef PLIC_H
+#define PLIC_H
+
+// Platform-Level Interrupt Controller on the QEMU virt machine
+#define UART0_IRQ 10
+
+void plic_enable(int irq, int hart);
+int plic_claim(void);
+void plic_complete(int irq);
+
+#endif
@@ -1,5 +1,6 @@
 #include <stdarg.h>
 #include "uart.h"
+#include "spinlock.h"
 
 static void print_num(unsigned long num, int base) {
     char digits[] = "0123456789abcdef";
@@ -21,9 +22,13 @@ static void print_num(unsigned long num, int base) {
     }
 }
 
+// Keeps lines from different harts from interleaving
+static spinlock_t printk_lock = SPINLOCK_INIT;
+
 void printk(const char *fmt, ...) {
     va_list args;
     va_start(args, fmt);
+    spin_lock(&printk_lock);
 
     for (const char *p = fmt; *p; p++) {
         if (*p != '%') {
@@ -68,5 +73,6 @@ void printk(const char *fmt, ...) {
         }
     }
 
+    spin_unlock(&printk_lock);
     va_end(args);
 }
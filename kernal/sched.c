@@ -1,11 +1,22 @@
 #include "sched.h"
 #include "printk.h"
 #include "mm.h"
+#include "timer.h"
 
 struct task tasks[MAX_TASKS];
-int current_task = 0;
 int num_tasks = 0;
 
+static spinlock_t task_table_lock = SPINLOCK_INIT;
+static spinlock_t edf_lock = SPINLOCK_INIT;  // Admission: every cpu->edf_bw
+static int next_cpu = 0;  // Round-robin placement of new tasks
+
+// Slots of exited tasks, oldest first, so a PID is not handed out again
+// while messages or wakeups aimed at its previous owner may be in flight
+static int free_head = -1, free_tail = -1;
+
+// Preemption timeslice; the timer is armed for it only under contention
+#define SCHED_TIMESLICE MS_TO_TIMER_TICKS(10)
+
 // Dummy task functions for testing
 void idle_task1(void) {
     static int count = 0;
@@ -14,8 +25,7 @@ void idle_task1(void) {
         if (count % 1000 == 0) {
             printk("[Task 1] Running (count: %d)...\n", count);
         }
-        for (volatile int i = 0; i < 100000; i++); // Simple delay
-        task_yield();
+        task_sleep_ms(100);
     }
 }
 
@@ -26,8 +36,7 @@ void idle_task2(void) {
         if (count % 1000 == 0) {
             printk("[Task 2] Running (count: %d)...\n", count);
         }
-        for (volatile int i = 0; i < 100000; i++); // Simple delay
-        task_yield();
+        task_sleep_ms(100);
     }
 }
 
@@ -38,11 +47,14 @@ void idle_task3(void) {
         if (count % 1000 == 0) {
             printk("[Task 3] Running (count: %d)...\n", count);
         }
-        for (volatile int i = 0; i < 100000; i++); // Simple delay
-        task_yield();
+        task_sleep_ms(100);
     }
 }
 
+static void rq_remove(struct cpu *cpu, int pid);
+static void wake_timeout(void *arg);
+static void edf_replenish(void *arg);
+
 void sched_init(void) {
     printk("[sched] Scheduler initializing...\n");
     
@@ -50,41 +62,392 @@ void sched_init(void) {
     for (int i = 0; i < MAX_TASKS; i++) {
         tasks[i].state = TASK_UNUSED;
         tasks[i].pid = i;
+        tasks[i].next_free = -1;
+        tasks[i].stack = 0;
+        tasks[i].stack_size = 0;
+        tasks[i].cpu = boot_hart;
+        tasks[i].on_cpu = 0;
+        tasks[i].on_rq = 0;
+        tasks[i].next_ready = tasks[i].prev_ready = -1;
+        tasks[i].affinity = AFFINITY_ALL;
+        tasks[i].priority = tasks[i].base_priority = SCHED_PRIO_DEFAULT;
+        tasks[i].pi_waiting_on = tasks[i].pi_waiters = tasks[i].pi_next = -1;
+        tasks[i].wait_reason = WAIT_NONE;
+        tasks[i].wake_deadline = 0;
+        ktimer_init(&tasks[i].wake_timer, wake_timeout, &tasks[i]);
+        tasks[i].edf_period = 0;
+        ktimer_init(&tasks[i].edf_timer, edf_replenish, &tasks[i]);
+        tasks[i].ipc_partner = -1;
+        tasks[i].handoff_hint = -1;
+        tasks[i].next_caller = -1;
+        tasks[i].caller_head = tasks[i].caller_tail = -1;
+        tasks[i].credit_wait_on = -1;
+        tasks[i].next_credit_waiter = -1;
+        tasks[i].notify_pending = 0;
+        tasks[i].notify_mask = 0;
+        tasks[i].notify_wait_mask = 0;
     }
     
     printk("[sched] Task table initialized\n");
     
-    // Trap vector setup causes system instability - keep disabled for now
-    // TODO: Debug trap vector issue in future phase
-    // set_trap_vector();
-    // printk("[sched] Trap vector set\n");
-    printk("[sched] Trap vector setup disabled (causes instability)\n");
+    // Boot hart's trap vector; secondaries set their own in secondary_main()
+    set_trap_vector();
+    printk("[sched] Trap vector set\n");
     
     // Create some test tasks
     create_task(idle_task1);
     create_task(idle_task2);
     create_task(idle_task3);
     
+    // kmain keeps running as task 0, taking over idle_task1's slot
+    struct cpu *cpu = &cpus[boot_hart];
+    spin_lock(&cpu->rq_lock);
+    rq_remove(cpu, 0);
+    tasks[0].state = TASK_RUNNING;
+    tasks[0].on_cpu = 1;
+    tasks[0].run_start = timer_now();
+    tasks[0].cycle_start = cycles_now();
+    spin_unlock(&cpu->rq_lock);
+    
+    // ...and keeps running on the boot stack
+    stack_free(tasks[0].stack, tasks[0].stack_size);
+    tasks[0].stack = 0;
+    
+    // The filler tasks only get leftover CPU time
+    sched_set_priority(1, SCHED_PRIO_IDLE);
+    sched_set_priority(2, SCHED_PRIO_IDLE);
+    
     printk("[sched] Created %d tasks\n", num_tasks);
     printk("[sched] Scheduler initialized.\n");
 }
 
+// EDF tasks queue apart from the priority levels, sorted by absolute
+// deadline (FIFO among equal ones). Reservations are few, so the linear
+// insert costs less than the bookkeeping of a heap would.
+static void edf_push(struct cpu *cpu, int pid) {
+    struct task *task = &tasks[pid];
+    int prev = -1;
+    int next = cpu->edf_head;
+    
+    while (next >= 0 && tasks[next].edf_abs_deadline <= task->edf_abs_deadline) {
+        prev = next;
+        next = tasks[next].next_ready;
+    }
+    task->prev_ready = prev;
+    task->next_ready = next;
+    if (prev >= 0) {
+        tasks[prev].next_ready = pid;
+    } else {
+        cpu->edf_head = pid;
+    }
+    if (next >= 0) {
+        tasks[next].prev_ready = pid;
+    }
+}
+
+static void edf_unlink(struct cpu *cpu, struct task *task) {
+    if (task->prev_ready >= 0) {
+        tasks[task->prev_ready].next_ready = task->next_ready;
+    } else {
+        cpu->edf_head = task->next_ready;
+    }
+    if (task->next_ready >= 0) {
+        tasks[task->next_ready].prev_ready = task->prev_ready;
+    }
+}
+
+// Ready-queue helpers; the caller holds cpu->rq_lock. Each priority level
+// is a FIFO and ready_bitmap marks the non-empty ones, so push, remove and
+// finding the best level are all constant time. EDF tasks go on edf_head.
+static void rq_push(struct cpu *cpu, int pid) {
+    struct task *task = &tasks[pid];
+    int prio = task->priority;
+    
+    if (task->edf_period) {
+        edf_push(cpu, pid);
+    } else {
+        task->next_ready = -1;
+        task->prev_ready = cpu->ready[prio].tail;
+        if (cpu->ready[prio].tail >= 0) {
+            tasks[cpu->ready[prio].tail].next_ready = pid;
+        } else {
+            cpu->ready[prio].head = pid;
+            cpu->ready_bitmap |= 1U << prio;
+        }
+        cpu->ready[prio].tail = pid;
+    }
+    cpu->nr_ready++;
+    task->on_rq = 1;
+}
+
+static void rq_remove(struct cpu *cpu, int pid) {
+    struct task *task = &tasks[pid];
+    int prio = task->priority;
+    
+    if (task->edf_period) {
+        edf_unlink(cpu, task);
+    } else {
+        if (task->prev_ready >= 0) {
+            tasks[task->prev_ready].next_ready = task->next_ready;
+        } else {
+            cpu->ready[prio].head = task->next_ready;
+        }
+        if (task->next_ready >= 0) {
+            tasks[task->next_ready].prev_ready = task->prev_ready;
+        } else {
+            cpu->ready[prio].tail = task->prev_ready;
+        }
+        if (cpu->ready[prio].head < 0) {
+            cpu->ready_bitmap &= ~(1U << prio);
+        }
+    }
+    task->next_ready = task->prev_ready = -1;
+    cpu->nr_ready--;
+    task->on_rq = 0;
+}
+
+// Ask the hart to reschedule if task outranks what it is running. Any EDF
+// task outranks every best-effort one; among EDF tasks the earlier
+// absolute deadline wins.
+static void check_preempt(struct cpu *cpu, struct task *task) {
+    if (cpu->current < 0) return;
+    
+    struct task *curr = &tasks[cpu->current];
+    if (task->edf_period) {
+        if (!curr->edf_period || task->edf_abs_deadline < curr->edf_abs_deadline) {
+            cpu->need_resched = 1;
+        }
+    } else if (!curr->edf_period && task->priority < curr->priority) {
+        cpu->need_resched = 1;
+    }
+}
+
+// An EDF task stays on the hart its bandwidth was admitted on (see
+// sched_set_edf()), so it is never stolen or pulled elsewhere
+static int cpu_allowed(struct task *task, int cpu) {
+    if (task->edf_period) return cpu == task->cpu;
+    return (task->affinity >> cpu) & 1;
+}
+
+// Tickless: arm this hart's timer for its nearest event, either the next
+// kernel timer on its wheel (task timeouts, sleeps, user timers) or the end
+// of the running task's slice when others are waiting for the CPU. With
+// neither, no timer interrupt is taken at all. A running EDF task has no
+// slice; the timer fires when its budget runs out instead. Called on the
+// hart itself with its rq_lock held.
+static void program_timer(struct cpu *cpu) {
+    unsigned long deadline = ktimer_next_expiry();
+    
+    if (cpu->current >= 0 && tasks[cpu->current].edf_period) {
+        struct task *task = &tasks[cpu->current];
+        unsigned long exhausted = task->edf_run_start + task->edf_budget;
+        if (exhausted < deadline) deadline = exhausted;
+    } else if (cpu->current >= 0 && cpu->nr_ready > 0 && cpu->slice_end < deadline) {
+        deadline = cpu->slice_end;
+    }
+    timer_set_deadline(deadline);
+}
+
+// After queueing task on cpu, make sure some hart will get to it. The
+// local timer is simply re-armed. A remote hart is interrupted only if it
+// is asleep in wfi, should preempt, or has no slice end armed; otherwise
+// an idle hart that could steal the task is woken instead.
+static void kick_cpu(struct cpu *cpu, struct task *task) {
+    if (cpu == this_cpu()) {
+        program_timer(cpu);
+        return;
+    }
+    
+    if (__atomic_load_n(&cpu->idle, __ATOMIC_ACQUIRE) || cpu->need_resched ||
+        cpu->timer_deadline > cpu->slice_end) {
+        smp_send_ipi(cpu->id);
+        return;
+    }
+    
+    for (int i = 0; i < MAX_HARTS; i++) {
+        if (cpus[i].online && __atomic_load_n(&cpus[i].idle, __ATOMIC_ACQUIRE) &&
+            cpu_allowed(task, i)) {
+            smp_send_ipi(i);
+            return;
+        }
+    }
+}
+
+// EDF bookkeeping: a constant bandwidth server per task. Each instance
+// (job) gets edf_runtime of budget and an absolute deadline edf_deadline
+// after its period starts; running charges the budget, and a task that
+// exhausts it is throttled (blocked with WAIT_THROTTLED) until its next
+// period, so an overrunning task cannot eat into anyone else's reservation.
+static void edf_new_period(struct task *task, unsigned long start) {
+    task->edf_abs_deadline = start + task->edf_deadline;
+    task->edf_next_period = start + task->edf_period;
+    task->edf_budget = task->edf_runtime;
+}
+
+// Charge a running EDF task for the time since edf_run_start
+static void edf_charge(struct task *task, unsigned long now) {
+    unsigned long used = now - task->edf_run_start;
+    task->edf_budget = (used < task->edf_budget) ? task->edf_budget - used : 0;
+    task->edf_run_start = now;
+}
+
+// Keep task off the CPU until edf_replenish() at its next period. Caller
+// holds the rq_lock of its home hart and has marked it blocked.
+static void edf_throttle(struct task *task) {
+    task->wait_reason = WAIT_THROTTLED;
+    task->wake_deadline = 0;
+    ktimer_arm(&task->edf_timer, task->edf_next_period);
+}
+
+// CBS wakeup rule: a task waking with budget left keeps its deadline only
+// if the budget fits the bandwidth still ahead of it; otherwise it starts
+// a fresh instance now. Returns 0 if it is out of budget and stays throttled.
+static int edf_wakeup(struct task *task) {
+    unsigned long now = timer_now();
+    
+    if (task->edf_budget == 0 && now < task->edf_next_period) {
+        edf_throttle(task);
+        return 0;
+    }
+    if (now >= task->edf_abs_deadline ||
+        task->edf_budget * task->edf_deadline > 
+        (task->edf_abs_deadline - now) * task->edf_runtime) {
+        edf_new_period(task, now);
+    }
+    return 1;
+}
+
+static void make_ready(struct cpu *cpu, struct task *task) {
+    if (task->edf_period && task->wait_reason != WAIT_THROTTLED && !edf_wakeup(task)) {
+        return;
+    }
+    task->state = TASK_READY;
+    task->wait_reason = WAIT_NONE;
+    task->wake_deadline = 0;
+    rq_push(cpu, task->pid);
+    check_preempt(cpu, task);
+    kick_cpu(cpu, task);
+}
+
+// Lock the ready queue of task's home hart. A steal can move the task
+// while we wait, so re-check the home once the lock is held.
+static struct cpu *lock_task_cpu(struct task *task) {
+    while (1) {
+        struct cpu *cpu = &cpus[__atomic_load_n(&task->cpu, __ATOMIC_ACQUIRE)];
+        spin_lock(&cpu->rq_lock);
+        if (task->cpu == cpu->id) return cpu;
+        spin_unlock(&cpu->rq_lock);
+    }
+}
+
+// Spread new tasks over the online harts the task may use
+static int pick_cpu(struct task *task) {
+    for (int i = 0; i < MAX_HARTS; i++) {
+        int cpu = next_cpu;
+        next_cpu = (next_cpu + 1) % MAX_HARTS;
+        if (cpus[cpu].online && cpu_allowed(task, cpu)) return cpu;
+    }
+    return boot_hart;
+}
+
+// Take a slot for a new task: a freed one if any, else a fresh one
+static int alloc_slot(void) {
+    int pid = -1;
+    
+    spin_lock(&task_table_lock);
+    if (free_head >= 0) {
+        pid = free_head;
+        free_head = tasks[pid].next_free;
+        if (free_head < 0) free_tail = -1;
+        tasks[pid].next_free = -1;
+    } else if (num_tasks < MAX_TASKS) {
+        pid = num_tasks++;
+    }
+    spin_unlock(&task_table_lock);
+    
+    return pid;
+}
+
+// Give an exited task's stack and slot back. Called from finish_switch(),
+// once the task's hart has switched away and nothing runs on the stack.
+static void release_task(struct task *task) {
+    if (task->stack && !stack_intact(task->stack)) {
+        printk("[sched] Task %d overran its %d byte stack\n", task->pid, task->stack_size);
+    }
+    stack_free(task->stack, task->stack_size);
+    task->stack = 0;
+    
+    spin_lock(&task_table_lock);
+    if (free_tail >= 0) {
+        tasks[free_tail].next_free = task->pid;
+    } else {
+        free_head = task->pid;
+    }
+    free_tail = task->pid;
+    spin_unlock(&task_table_lock);
+}
+
 int create_task(void (*entry)(void)) {
-    if (num_tasks >= MAX_TASKS) {
+    return create_task_stack(entry, TASK_STACK_SIZE);
+}
+
+// Create a task running entry on a stack of at least stack_size bytes
+// (rounded up to a power of two, STACK_MIN_SIZE..STACK_MAX_SIZE)
+int create_task_stack(void (*entry)(void), unsigned int stack_size) {
+    unsigned int actual;
+    char *stack = stack_alloc(stack_size, &actual);
+    if (!stack) {
+        printk("[sched] Cannot create task: no %d byte stack\n", stack_size);
+        return -1;
+    }
+    
+    int pid = alloc_slot();
+    if (pid < 0) {
+        stack_free(stack, actual);
         printk("[sched] Cannot create task: task table full\n");
         return -1;
     }
     
-    struct task *task = &tasks[num_tasks];
-    task->state = TASK_READY;
-    task->pid = num_tasks;
+    struct task *task = &tasks[pid];
+    task->pid = pid;
+    task->stack = stack;
+    task->stack_size = actual;
+    task->affinity = AFFINITY_ALL;
+    task->priority = task->base_priority = SCHED_PRIO_DEFAULT;
+    task->pi_waiting_on = task->pi_waiters = task->pi_next = -1;
+    task->cpu = pick_cpu(task);
+    task->on_cpu = 0;
+    task->wait_reason = WAIT_NONE;
+    task->wake_deadline = 0;
+    ktimer_init(&task->wake_timer, wake_timeout, task);
+    task->edf_runtime = task->edf_period = task->edf_deadline = 0;
+    task->edf_budget = task->edf_misses = 0;
+    ktimer_init(&task->edf_timer, edf_replenish, task);
+    for (int i = 0; i < TASK_TIMERS; i++) {
+        ktimer_init(&task->timers[i].timer, 0, 0);
+    }
+    task->ipc_regs.count = 0;
+    task->ipc_partner = -1;
+    task->handoff_hint = -1;
+    task->next_caller = -1;
+    task->caller_head = task->caller_tail = -1;
+    task->credit_wait_on = -1;
+    task->next_credit_waiter = -1;
+    task->notify_pending = 0;
+    task->notify_mask = 0;
+    task->notify_wait_mask = 0;
+    task->cycles = task->run_time = task->blocked_time = 0;
+    task->nvcsw = task->nivcsw = 0;
+    task->msgs_sent = task->bytes_sent = 0;
+    task->msgs_recv = task->bytes_recv = 0;
     
-    // Set up initial context
-    task->context.ra = (unsigned long)entry;
-    task->context.sp = (unsigned long)&task->stack[TASK_STACK_SIZE - 1];
+    // Set up initial context: the trampoline finishes the first switch
+    // and then calls entry from s0
+    task->context.ra = (unsigned long)task_trampoline;
+    task->context.sp = ((unsigned long)stack + actual) & ~15UL;
     
     // Clear other registers
-    task->context.s0 = 0;
+    task->context.s0 = (unsigned long)entry;
     task->context.s1 = 0;
     task->context.s2 = 0;
     task->context.s3 = 0;
@@ -97,64 +460,991 @@ int create_task(void (*entry)(void)) {
     task->context.s10 = 0;
     task->context.s11 = 0;
     
-    num_tasks++;
-    printk("[sched] Created task %d\n", task->pid);
+    struct cpu *cpu = &cpus[task->cpu];
+    spin_lock(&cpu->rq_lock);
+    make_ready(cpu, task);
+    spin_unlock(&cpu->rq_lock);
+    
+    printk("[sched] Created task %d on hart %d\n", task->pid, task->cpu);
     return task->pid;
 }
 
-void schedule(void) {
-    if (num_tasks <= 1) return; // Nothing to schedule
+// wake_timer callback: a blocked task's deadline has passed. The timer may
+// be stale (the task woke and blocked again), so check the deadline itself.
+static void wake_timeout(void *arg) {
+    struct task *task = arg;
+    struct cpu *cpu = lock_task_cpu(task);
+    
+    if (task->state == TASK_BLOCKED && task->wake_deadline &&
+        timer_now() >= task->wake_deadline) {
+        make_ready(cpu, task);
+    }
+    spin_unlock(&cpu->rq_lock);
+}
+
+// edf_timer callback: a throttled task's next period has come. A timer
+// running late starts the instance now rather than hand out a deadline
+// that has already passed.
+static void edf_replenish(void *arg) {
+    struct task *task = arg;
+    struct cpu *cpu = lock_task_cpu(task);
+    
+    if (task->edf_period && task->state == TASK_BLOCKED && 
+        task->wait_reason == WAIT_THROTTLED) {
+        unsigned long now = timer_now();
+        unsigned long start = task->edf_next_period;
+        if (now >= start + task->edf_deadline) start = now;
+        edf_new_period(task, start);
+        make_ready(cpu, task);
+    }
+    spin_unlock(&cpu->rq_lock);
+}
+
+// Can this hart switch to task? Its context must be saved (or be the one
+// running here), and its affinity must include this hart.
+static int runnable_here(struct cpu *cpu, struct task *task) {
+    return (!task->on_cpu || task->pid == cpu->current) && cpu_allowed(task, cpu->id);
+}
+
+// Take the most urgent runnable task off this hart's queue, or -1: the
+// earliest-deadline EDF task, else the best priority level. The bitmap
+// gives that level directly; the inner loops only step past tasks still
+// being switched out or not allowed on this hart.
+static int pick_next(struct cpu *cpu) {
+    for (int pid = cpu->edf_head; pid >= 0; pid = tasks[pid].next_ready) {
+        if (runnable_here(cpu, &tasks[pid])) {
+            rq_remove(cpu, pid);
+            return pid;
+        }
+    }
+    
+    unsigned int levels = cpu->ready_bitmap;
+    
+    while (levels) {
+        int prio = __builtin_ctz(levels);
+        levels &= levels - 1;
+        
+        for (int pid = cpu->ready[prio].head; pid >= 0; pid = tasks[pid].next_ready) {
+            if (runnable_here(cpu, &tasks[pid])) {
+                rq_remove(cpu, pid);
+                return pid;
+            }
+        }
+    }
+    return -1;
+}
+
+// Work stealing: an idle hart takes a task from the tail of the longest
+// other queue. The victim is only try-locked, so a thief never waits on a
+// busy hart and two thieves cannot deadlock. Caller holds thief->rq_lock.
+static int steal_task(struct cpu *thief) {
+    int victim = -1;
+    int longest = 0;
     
-    struct task *old_task = &tasks[current_task];
+    for (int i = 0; i < MAX_HARTS; i++) {
+        if (i == thief->id || !cpus[i].online) continue;
+        int queued = __atomic_load_n(&cpus[i].nr_ready, __ATOMIC_RELAXED);
+        if (queued > longest) {
+            longest = queued;
+            victim = i;
+        }
+    }
     
-    // Find next ready task (round-robin)
-    int next_task = (current_task + 1) % num_tasks;
-    while (next_task != current_task && tasks[next_task].state != TASK_READY) {
-        next_task = (next_task + 1) % num_tasks;
+    if (victim < 0) return -1;
+    
+    struct cpu *cpu = &cpus[victim];
+    if (!spin_trylock(&cpu->rq_lock)) return -1;
+    
+    // Least urgent level first, from its tail: the task its owner would run last
+    unsigned int levels = cpu->ready_bitmap;
+    while (levels) {
+        int prio = 31 - __builtin_clz(levels);
+        levels &= ~(1U << prio);
+        
+        for (int pid = cpu->ready[prio].tail; pid >= 0; pid = tasks[pid].prev_ready) {
+            struct task *task = &tasks[pid];
+            if (task->on_cpu || !cpu_allowed(task, thief->id)) continue;
+            
+            rq_remove(cpu, pid);
+            __atomic_store_n(&task->cpu, thief->id, __ATOMIC_RELEASE);
+            spin_unlock(&cpu->rq_lock);
+            
+            thief->steals++;
+            return pid;
+        }
     }
     
-    if (next_task == current_task) return; // No other ready tasks
+    spin_unlock(&cpu->rq_lock);
+    return -1;
+}
+
+// Lock the queue of the hart we are running on. Interrupts go off first so
+// the timer cannot preempt and migrate us between reading tp and locking.
+static struct cpu *lock_this_cpu(void) {
+    irq_push_off();
+    struct cpu *cpu = this_cpu();
+    spin_lock(&cpu->rq_lock);
+    irq_pop_off();
+    return cpu;
+}
+
+// Runs on the resumed side of every switch: the task switched away from is
+// now saved and may be stolen, and the ready queue can be unlocked
+static void finish_switch(void) {
+    struct cpu *cpu = this_cpu();
+    if (cpu->last >= 0) {
+        struct task *last = &tasks[cpu->last];
+        __atomic_store_n(&last->on_cpu, 0, __ATOMIC_RELEASE);
+        if (last->state == TASK_UNUSED) {
+            release_task(last);
+        }
+        cpu->last = -1;
+    }
+    program_timer(cpu);
+    spin_unlock(&cpu->rq_lock);
+}
+
+// Nothing on this hart can run: sleep in wfi until an interrupt. Called
+// and returns with cpu->rq_lock held. Interrupts stay off throughout so a
+// handler cannot run in between; a pending one still ends the wfi and is
+// taken once the caller re-enables interrupts. A hart whose timer is not
+// live yet keeps spinning instead, as nothing would wake it.
+static void cpu_idle(struct cpu *cpu) {
+    program_timer(cpu);
+    if (!cpu->timer_live) return;
+    
+    irq_push_off();
+    __atomic_store_n(&cpu->idle, 1, __ATOMIC_RELEASE);
+    spin_unlock(&cpu->rq_lock);
+    
+    unsigned long start = timer_now();
+    asm volatile("wfi");
+    cpu->idle_time += timer_now() - start;
+    
+    __atomic_store_n(&cpu->idle, 0, __ATOMIC_RELEASE);
+    spin_lock(&cpu->rq_lock);
+    irq_pop_off();
+}
+
+// How a switch came about: feeds the voluntary/involuntary counters and
+// decides whether the incoming task inherits the outgoing one's slice
+enum switch_kind {
+    SWITCH_VOLUNTARY,   // Blocked, exited or yielded
+    SWITCH_PREEMPT,     // Timer, IPI or a more urgent wakeup
+    SWITCH_DONATE       // Directed handoff: the rest of the slice goes along
+};
+
+// Charge the outgoing task for its run and start the incoming one's clock.
+// A switch counts as involuntary only when a still-runnable task is
+// preempted; blocking, exiting, yielding and handoffs are voluntary.
+static void account_switch(int prev_task, int next_task, enum switch_kind how) {
+    unsigned long now = timer_now();
+    unsigned long cycles = cycles_now();
     
-    struct task *new_task = &tasks[next_task];
+    if (prev_task >= 0) {
+        struct task *prev = &tasks[prev_task];
+        prev->run_time += now - prev->run_start;
+        prev->cycles += cycles - prev->cycle_start;
+        if (how == SWITCH_PREEMPT && prev->state == TASK_READY) {
+            prev->nivcsw++;
+        } else {
+            prev->nvcsw++;
+        }
+    }
+    if (next_task >= 0) {
+        tasks[next_task].run_start = now;
+        tasks[next_task].cycle_start = cycles;
+        tasks[next_task].edf_run_start = now;
+    }
+}
+
+// Switch this hart to next_task (-1 = its idle context). Called with
+// cpu->rq_lock held; whichever task resumes here releases it.
+static void switch_to(struct cpu *cpu, int next_task, enum switch_kind how) {
+    int prev_task = cpu->current;
+    struct task_context *old_context = (prev_task >= 0) ? &tasks[prev_task].context 
+                                                        : &cpu->idle_context;
+    struct task_context *new_context = (next_task >= 0) ? &tasks[next_task].context 
+                                                        : &cpu->idle_context;
     
     // Reduce debug output to prevent spam
-    static int switch_count = 0;
-    switch_count++;
-    if (switch_count % 100 == 0) {
-        printk("[sched] Switch #%d: task %d -> task %d\n", switch_count, current_task, next_task);
+    cpu->switches++;
+    if (cpu->switches % 100 == 0) {
+        printk("[sched] Hart %d switch #%ld: task %d -> task %d\n", 
+               cpu->id, cpu->switches, prev_task, next_task);
     }
     
-    // Update task states
-    if (old_task->state == TASK_RUNNING) {
-        old_task->state = TASK_READY;
+    account_switch(prev_task, next_task, how);
+    
+    // The guard words are the only overflow check there is: no MMU, so no
+    // guard pages. Running on is pointless once a neighbour is corrupted.
+    if (prev_task >= 0 && tasks[prev_task].stack && tasks[prev_task].state != TASK_UNUSED &&
+        !stack_intact(tasks[prev_task].stack)) {
+        printk("[sched] Task %d overran its %d byte stack\n", 
+               prev_task, tasks[prev_task].stack_size);
+        printk("[sched] Halting hart %d\n", cpu->id);
+        while (1);
     }
-    new_task->state = TASK_RUNNING;
     
-    current_task = next_task;
+    if (next_task >= 0) {
+        tasks[next_task].state = TASK_RUNNING;
+        tasks[next_task].on_cpu = 1;
+    }
+    cpu->current = next_task;
+    cpu->last = prev_task;
+    
+    // A handoff runs the incoming task on what is left of the outgoing
+    // one's slice, so a client and server passing the CPU back and forth
+    // cannot hold it longer than one task would
+    unsigned long now = timer_now();
+    if (how != SWITCH_DONATE || cpu->slice_end <= now) {
+        cpu->slice_end = now + SCHED_TIMESLICE;
+    }
+    
+    // Whether interrupts were on belongs to the task, not the hart: a task
+    // switched out from the timer trap must come back with them off
+    int irq_enabled = cpu->irq_enabled;
     
     // Perform context switch
-    context_switch(&old_task->context, &new_task->context);
+    context_switch(old_context, new_context);
+    
+    this_cpu()->irq_enabled = irq_enabled;
+    finish_switch();
+}
+
+// Called first by a new task (from task_trampoline) to finish the switch.
+// Tasks start with interrupts on, so they can be preempted.
+void task_start(void) {
+    this_cpu()->irq_enabled = 1;
+    finish_switch();
+}
+
+// The IPC receiver prev last woke (see post_message()), if it is queued
+// here and nothing more urgent is. Running it next turns a request around
+// without first cycling through every other ready task at its level.
+static int take_handoff_hint(struct cpu *cpu, int prev_task) {
+    if (prev_task < 0) return -1;
+    
+    int pid = tasks[prev_task].handoff_hint;
+    tasks[prev_task].handoff_hint = -1;
+    if (pid < 0 || pid == prev_task || cpu->edf_head >= 0) return -1;
+    
+    struct task *task = &tasks[pid];
+    if (task->cpu != cpu->id || !task->on_rq || !runnable_here(cpu, task) ||
+        __builtin_ctz(cpu->ready_bitmap) < task->priority) {
+        return -1;
+    }
+    
+    rq_remove(cpu, pid);
+    return pid;
+}
+
+// how is SWITCH_PREEMPT when the running task is being switched out
+// against its will (timer, IPI or a wakeup of a more urgent task), in which
+// case its handoff hint is not honoured.
+static void do_schedule(enum switch_kind how) {
+    // Due timers first: their callbacks take queue locks themselves
+    ktimer_run();
+    
+    struct cpu *cpu = lock_this_cpu();
+    cpu->need_resched = 0;
+    
+    // Round-robin within a level: a running task goes to the back of its queue
+    int prev_task = cpu->current;
+    if (prev_task >= 0 && tasks[prev_task].edf_period) {
+        edf_charge(&tasks[prev_task], timer_now());
+    }
+    if (prev_task >= 0 && tasks[prev_task].state == TASK_RUNNING) {
+        tasks[prev_task].state = TASK_READY;
+        rq_push(cpu, prev_task);
+    }
+    
+    int next_task = -1;
+    if (how != SWITCH_PREEMPT) {
+        next_task = take_handoff_hint(cpu, prev_task);
+        if (next_task >= 0) how = SWITCH_DONATE;
+    }
+    if (next_task < 0) {
+        next_task = pick_next(cpu);
+    }
+    if (next_task < 0) {
+        next_task = steal_task(cpu);
+    }
+    
+    if (next_task < 0 || next_task == prev_task) {
+        // Nothing else to run: stay on the current task, with a fresh slice.
+        // If it is blocked or exiting (or this is the idle context) the hart
+        // sleeps first; then the caller re-checks its wait condition.
+        if (prev_task >= 0) {
+            struct task *prev = &tasks[prev_task];
+            if (prev->on_rq) {
+                rq_remove(cpu, prev_task); // queued but not allowed here
+            }
+            if (prev->state == TASK_READY) {
+                prev->state = TASK_RUNNING;
+            }
+        }
+        
+        if (prev_task < 0 || tasks[prev_task].state != TASK_RUNNING) {
+            cpu_idle(cpu);
+            if (prev_task >= 0) {
+                tasks[prev_task].edf_run_start = timer_now(); // Idling is not charged
+            }
+        } else {
+            cpu->slice_end = timer_now() + SCHED_TIMESLICE;
+            program_timer(cpu);
+        }
+        spin_unlock(&cpu->rq_lock);
+        return;
+    }
+    
+    switch_to(cpu, next_task, how);
+}
+
+void schedule(void) {
+    do_schedule(SWITCH_VOLUNTARY);
+}
+
+// Involuntary reschedule, from the trap handler or on the way out of a
+// syscall when need_resched is set
+void sched_preempt(void) {
+    do_schedule(SWITCH_PREEMPT);
+}
+
+// Move a ready task queued on another hart onto this one for a directed
+// switch. As with a steal, the other queue is only try-locked, so this
+// can fail. Caller holds cpu->rq_lock.
+static void pull_task(struct cpu *cpu, struct task *task) {
+    struct cpu *home = &cpus[__atomic_load_n(&task->cpu, __ATOMIC_ACQUIRE)];
+    if (home == cpu || !spin_trylock(&home->rq_lock)) return;
+    
+    if (task->cpu == home->id && task->state == TASK_READY && task->on_rq &&
+        !task->on_cpu && cpu_allowed(task, cpu->id)) {
+        rq_remove(home, task->pid);
+        __atomic_store_n(&task->cpu, cpu->id, __ATOMIC_RELEASE);
+        rq_push(cpu, task->pid);
+    }
+    spin_unlock(&home->rq_lock);
+}
+
+// Hand the CPU straight to a ready task, skipping the queue order, along
+// with the rest of the current slice. A target queued on another hart is
+// pulled over if it may run here. Falls back to schedule() otherwise.
+void schedule_to(int pid) {
+    if (pid < 0 || pid >= num_tasks) {
+        schedule();
+        return;
+    }
+    
+    struct cpu *cpu = lock_this_cpu();
+    if (pid == cpu->current) {
+        spin_unlock(&cpu->rq_lock);
+        schedule();
+        return;
+    }
+    
+    struct task *task = &tasks[pid];
+    if (task->cpu != cpu->id) {
+        pull_task(cpu, task);
+    }
+    // Nor may a handoff jump a best-effort task over a queued EDF one
+    if (task->cpu != cpu->id || task->state != TASK_READY || !task->on_rq ||
+        !runnable_here(cpu, task) || (cpu->edf_head >= 0 && !task->edf_period)) {
+        spin_unlock(&cpu->rq_lock);
+        schedule();
+        return;
+    }
+    
+    int prev_task = cpu->current;
+    if (prev_task >= 0 && tasks[prev_task].edf_period) {
+        edf_charge(&tasks[prev_task], timer_now());
+    }
+    if (prev_task >= 0 && tasks[prev_task].state == TASK_RUNNING) {
+        tasks[prev_task].state = TASK_READY;
+        rq_push(cpu, prev_task);
+    }
+    
+    rq_remove(cpu, pid);
+    switch_to(cpu, pid, SWITCH_DONATE);
+}
+
+// Directed yield: let pid run now on the rest of our slice, going to the
+// back of our own queue. Plain yield if pid is not ready.
+void yield_to(int pid) {
+    int held = kernel_lock_drop();
+    schedule_to(pid);
+    kernel_lock_restore(held);
 }
 
 void task_yield(void) {
     // Only schedule if we have multiple tasks and they're properly initialized
     if (num_tasks > 1) {
+        int held = kernel_lock_drop();
         schedule();
+        kernel_lock_restore(held);
     }
 }
 
-void sched_tick(void) {
-    // Called by timer interrupt - be quiet to avoid spam
-    static int tick_count = 0;
-    tick_count++;
+// The running task is never stolen, so its home is this hart
+static void block_current(wait_reason_t reason, unsigned long deadline) {
+    struct cpu *cpu = lock_this_cpu();
+    struct task *task = &tasks[cpu->current];
     
-    // Only print every 50 ticks to reduce output
-    if (tick_count % 50 == 0) {
-        printk("[sched] Timer tick %d\n", tick_count);
+    task->state = TASK_BLOCKED;
+    task->wait_reason = reason;
+    task->wake_deadline = deadline;
+    task->block_start = timer_now();
+    if (deadline) {
+        ktimer_arm(&task->wake_timer, deadline);
     }
+    spin_unlock(&cpu->rq_lock);
+}
+
+static void unblock_current(void) {
+    // Back here either because we were woken or nothing else was runnable;
+    // callers re-check their wait condition
+    struct cpu *cpu = lock_this_cpu();
+    struct task *task = &tasks[cpu->current];
     
-    // Only schedule if we have tasks and they're ready
-    if (num_tasks > 1) {
+    if (task->on_rq) {
+        // Woken by another hart before we switched away
+        rq_remove(cpu, task->pid);
+    }
+    task->state = TASK_RUNNING;
+    task->wait_reason = WAIT_NONE;
+    task->wake_deadline = 0;
+    task->blocked_time += timer_now() - task->block_start;
+    ktimer_cancel(&task->wake_timer);
+    spin_unlock(&cpu->rq_lock);
+}
+
+// Block the current task until task_wakeup() is called for the same reason
+// or the deadline (an mtime value, 0 = no timeout) passes. The task is marked
+// blocked before the kernel lock is dropped, so a wakeup cannot be missed.
+void task_block(wait_reason_t reason, unsigned long deadline) {
+    block_current(reason, deadline);
+    int held = kernel_lock_drop();
+    schedule();
+    unblock_current();
+    kernel_lock_restore(held);
+}
+
+// Like task_block(), but for wakeups from interrupt context, where the
+// kernel lock cannot close the race: ready() is re-checked once the task
+// is marked blocked, and a wakeup after that finds it blocked.
+void task_block_unless(wait_reason_t reason, unsigned long deadline, int (*ready)(void)) {
+    block_current(reason, deadline);
+    if (ready()) {
+        unblock_current();
+        return;
+    }
+    
+    int held = kernel_lock_drop();
+    schedule();
+    unblock_current();
+    kernel_lock_restore(held);
+}
+
+// Sleep until mtime reaches deadline; the hart idles if nothing else runs
+void sleep_until(unsigned long deadline) {
+    while (timer_now() < deadline) {
+        task_block(WAIT_SLEEP, deadline);
+    }
+}
+
+void task_sleep_ms(int ms) {
+    sleep_until(timer_now() + MS_TO_TIMER_TICKS(ms));
+}
+
+// Sit out a throttle of the current task until edf_replenish() readies it
+static void edf_wait(struct task *task, enum switch_kind how) {
+    while (task->state != TASK_RUNNING) {
+        do_schedule(how);
+    }
+    task->blocked_time += timer_now() - task->block_start;
+}
+
+// End the current EDF instance: a periodic task calls this when its job
+// is done and sleeps until its next period, which brings a fresh budget
+// and deadline. A job finishing past its deadline counts as a miss.
+// Best-effort callers simply yield.
+void edf_yield(void) {
+    struct cpu *cpu = lock_this_cpu();
+    struct task *task = &tasks[cpu->current];
+    
+    if (!task->edf_period) {
+        spin_unlock(&cpu->rq_lock);
+        task_yield();
+        return;
+    }
+    
+    unsigned long now = timer_now();
+    if (now > task->edf_abs_deadline) {
+        task->edf_misses++;
+    }
+    
+    if (now >= task->edf_next_period) {
+        // Overran into the next period: that instance starts right away
+        edf_new_period(task, now);
+        spin_unlock(&cpu->rq_lock);
+        task_yield();
+        return;
+    }
+    
+    task->edf_budget = 0;
+    task->state = TASK_BLOCKED;
+    task->block_start = now;
+    edf_throttle(task);
+    spin_unlock(&cpu->rq_lock);
+    
+    int held = kernel_lock_drop();
+    edf_wait(task, SWITCH_VOLUNTARY);
+    kernel_lock_restore(held);
+}
+
+// Terminate the calling task. Timers and IPC state go now; the stack and
+// slot only once this hart has switched away (see finish_switch()), as the
+// task runs on that stack until then. Does not return.
+void task_exit(void) {
+    struct task *task = &tasks[current_task];
+    
+    // Also reached from task_trampoline, outside any syscall
+    kernel_lock();
+    for (int i = 0; i < TASK_TIMERS; i++) {
+        ktimer_cancel(&task->timers[i].timer);
+    }
+    ipc_task_exit(task->pid);
+    if (task->edf_period) {
+        sched_set_edf(task->pid, 0, 0, 0);  // Return its bandwidth
+    }
+    
+    // Waiters still lending us priority are woken by ipc_task_exit()
+    pi_release(task->pid);
+    for (int w = task->pi_waiters; w >= 0; ) {
+        int next = tasks[w].pi_next;
+        tasks[w].pi_waiting_on = tasks[w].pi_next = -1;
+        w = next;
+    }
+    task->pi_waiters = -1;
+    
+    struct cpu *cpu = lock_this_cpu();
+    task->state = TASK_UNUSED;
+    spin_unlock(&cpu->rq_lock);
+    
+    kernel_lock_drop();
+    while (1) {
         schedule();
     }
 }
+
+// Block the current task and run pid next (used by the IPC call/reply path)
+void task_block_handoff(wait_reason_t reason, int pid) {
+    block_current(reason, 0);
+    int held = kernel_lock_drop();
+    schedule_to(pid);
+    unblock_current();
+    kernel_lock_restore(held);
+}
+
+// Make a task blocked for the given reason runnable again, on its home hart
+void task_wakeup(int pid, wait_reason_t reason) {
+    if (pid < 0 || pid >= num_tasks) return;
+    
+    struct task *task = &tasks[pid];
+    struct cpu *cpu = lock_task_cpu(task);
+    if (task->state == TASK_BLOCKED && task->wait_reason == reason) {
+        make_ready(cpu, task);
+    }
+    spin_unlock(&cpu->rq_lock);
+}
+
+// Restrict pid to the harts in mask. A queued task left on a hart it may
+// no longer use is skipped there and picked up by an allowed hart's steal.
+int sched_set_affinity(int pid, unsigned long mask) {
+    if (pid < 0 || pid >= num_tasks || tasks[pid].state == TASK_UNUSED) {
+        printk("[sched] Invalid task %d for affinity\n", pid);
+        return -1;
+    }
+    
+    unsigned long online = 0;
+    for (int i = 0; i < MAX_HARTS; i++) {
+        if (cpus[i].online) online |= 1UL << i;
+    }
+    
+    if (!(mask & online)) {
+        printk("[sched] Affinity 0x%lx for task %d has no online hart\n", mask, pid);
+        return -1;
+    }
+    
+    struct task *task = &tasks[pid];
+    struct cpu *cpu = lock_task_cpu(task);
+    task->affinity = mask;
+    spin_unlock(&cpu->rq_lock);
+    
+    return 0;
+}
+
+// Set a task's effective priority, requeueing it at the new level if it is
+// ready. A running task that drops below a queued one gives way at its
+// next preemption point.
+static void change_priority(struct task *task, int priority) {
+    struct cpu *cpu = lock_task_cpu(task);
+    
+    if (task->on_rq) {
+        rq_remove(cpu, task->pid);
+        task->priority = priority;
+        rq_push(cpu, task->pid);
+        check_preempt(cpu, task);
+        kick_cpu(cpu, task);
+    } else {
+        task->priority = priority;
+        if (cpu->current == task->pid && cpu->ready_bitmap &&
+            __builtin_ctz(cpu->ready_bitmap) < priority) {
+            cpu->need_resched = 1;
+        }
+    }
+    
+    spin_unlock(&cpu->rq_lock);
+}
+
+// Priority inheritance. A task blocked on another (for its reply, for its
+// answer to a call, or for room in its queue) lends it its priority: each
+// task runs at the most urgent of its base priority and its waiters'
+// effective priorities, passed along chains of waits up to PI_MAX_DEPTH
+// (which also stops a wait cycle). Waiter lists change under the kernel lock.
+#define PI_MAX_DEPTH 8
+
+static void pi_recompute(int pid) {
+    for (int depth = 0; pid >= 0 && depth < PI_MAX_DEPTH; depth++) {
+        struct task *task = &tasks[pid];
+        int priority = task->base_priority;
+        
+        for (int w = task->pi_waiters; w >= 0; w = tasks[w].pi_next) {
+            if (tasks[w].priority < priority) priority = tasks[w].priority;
+        }
+        if (priority == task->priority) return;
+        
+        change_priority(task, priority);
+        pid = task->pi_waiting_on;
+    }
+}
+
+// The current task is about to block on owner: boost owner if need be
+void pi_wait_on(int owner) {
+    struct task *self = &tasks[current_task];
+    if (self->pi_waiting_on == owner) return;
+    
+    pi_release(current_task);
+    if (owner < 0 || owner >= num_tasks || owner == current_task ||
+        tasks[owner].state == TASK_UNUSED) {
+        return;
+    }
+    
+    self->pi_waiting_on = owner;
+    self->pi_next = tasks[owner].pi_waiters;
+    tasks[owner].pi_waiters = current_task;
+    pi_recompute(owner);
+}
+
+// pid no longer waits on anyone (answered, timed out or interrupted): drop
+// the boost it lent. Called by whoever ends the wait, so a server loses the
+// boost as it replies rather than when the client next runs.
+void pi_release(int pid) {
+    struct task *task = &tasks[pid];
+    int owner = task->pi_waiting_on;
+    if (owner < 0) return;
+    
+    int *link = &tasks[owner].pi_waiters;
+    while (*link >= 0 && *link != pid) {
+        link = &tasks[*link].pi_next;
+    }
+    if (*link == pid) {
+        *link = task->pi_next;
+    }
+    task->pi_waiting_on = -1;
+    task->pi_next = -1;
+    pi_recompute(owner);
+}
+
+// Change a task's base priority. It keeps any more urgent priority it is
+// inheriting, and a task it waits on is re-evaluated.
+int sched_set_priority(int pid, int priority) {
+    if (pid < 0 || pid >= num_tasks || tasks[pid].state == TASK_UNUSED ||
+        priority < 0 || priority >= SCHED_PRIO_LEVELS) {
+        printk("[sched] Invalid priority %d for task %d\n", priority, pid);
+        return -1;
+    }
+    
+    tasks[pid].base_priority = priority;
+    pi_recompute(pid);
+    return 0;
+}
+
+// Make pid an EDF task with a reservation of runtime every period, due
+// deadline after each period starts (0 = at the end of the period); all in
+// mtime ticks, runtime <= deadline <= period. runtime 0 returns it to best
+// effort. Admission control: the reservation is accepted only if the
+// summed density (runtime / deadline) of the hart's EDF tasks stays within
+// EDF_BW_MAX, which keeps every admitted deadline feasible there. If the
+// task's hart is full, another hart in its affinity with room is used,
+// unless the task is running right now.
+int sched_set_edf(int pid, unsigned long runtime, unsigned long period, unsigned long deadline) {
+    if (deadline == 0) deadline = period;
+    if (pid < 0 || pid >= num_tasks || tasks[pid].state == TASK_UNUSED ||
+        (runtime && (runtime > deadline || deadline > period || period > EDF_MAX_PERIOD))) {
+        printk("[sched] Invalid EDF reservation %ld/%ld/%ld for task %d\n", 
+               runtime, period, deadline, pid);
+        return -1;
+    }
+    
+    struct task *task = &tasks[pid];
+    struct cpu *cpu = lock_task_cpu(task);
+    unsigned long bw = runtime ? (runtime << EDF_BW_SHIFT) / deadline : 0;
+    unsigned long old_bw = task->edf_period ? 
+        (task->edf_runtime << EDF_BW_SHIFT) / task->edf_deadline : 0;
+    
+    spin_lock(&edf_lock);
+    int target = -1;
+    if (cpu->edf_bw - old_bw + bw <= EDF_BW_MAX) {
+        target = cpu->id;
+    } else if (!task->on_cpu) {
+        for (int i = 0; i < MAX_HARTS; i++) {
+            if (cpus[i].online && ((task->affinity >> i) & 1) &&
+                cpus[i].edf_bw + bw <= EDF_BW_MAX) {
+                target = i;
+                break;
+            }
+        }
+    }
+    if (target < 0) {
+        spin_unlock(&edf_lock);
+        spin_unlock(&cpu->rq_lock);
+        printk("[sched] EDF admission failed for task %d: no hart has %ld%% to spare\n", 
+               pid, (bw * 100) >> EDF_BW_SHIFT);
+        return -1;
+    }
+    cpu->edf_bw -= old_bw;
+    cpus[target].edf_bw += bw;
+    spin_unlock(&edf_lock);
+    
+    // Change class off the queue, which is ordered by it
+    int queued = task->on_rq;
+    if (queued) {
+        rq_remove(cpu, pid);
+    }
+    task->edf_runtime = runtime;
+    task->edf_period = runtime ? period : 0;
+    task->edf_deadline = deadline;
+    task->edf_run_start = timer_now();
+    if (runtime) {
+        edf_new_period(task, task->edf_run_start);
+    } else {
+        ktimer_cancel(&task->edf_timer);
+    }
+    
+    if (target != cpu->id) {
+        // Not running, so free to move; a wakeup meanwhile queues it there
+        __atomic_store_n(&task->cpu, target, __ATOMIC_RELEASE);
+        spin_unlock(&cpu->rq_lock);
+        cpu = &cpus[target];
+        spin_lock(&cpu->rq_lock);
+    }
+    
+    if (queued) {
+        rq_push(cpu, pid);
+        check_preempt(cpu, task);
+        kick_cpu(cpu, task);
+    } else if (task->state == TASK_BLOCKED && task->wait_reason == WAIT_THROTTLED) {
+        // The new reservation (or none) starts now
+        ktimer_cancel(&task->edf_timer);
+        make_ready(cpu, task);
+    } else if (cpu->current == pid) {
+        // Re-evaluate against the queue and re-arm for the new budget
+        cpu->need_resched = 1;
+        kick_cpu(cpu, task);
+    }
+    spin_unlock(&cpu->rq_lock);
+    
+    return 0;
+}
+
+// Yield if a more urgent task became ready on this hart. Called on the way
+// out of a syscall, which is this kernel's preemption point.
+void sched_preempt_check(void) {
+    // A stale read after migrating only costs an extra yield or a late one
+    if (this_cpu()->need_resched && num_tasks > 1) {
+        int held = kernel_lock_drop();
+        sched_preempt();
+        kernel_lock_restore(held);
+    }
+}
+
+int sched_hart_stats(int hart, struct hart_stats *stats) {
+    if (hart < 0 || hart >= MAX_HARTS || !stats) return -1;
+    
+    struct cpu *cpu = &cpus[hart];
+    stats->online = cpu->online;
+    stats->current = cpu->current;
+    stats->nr_ready = cpu->nr_ready;
+    stats->switches = cpu->switches;
+    stats->steals = cpu->steals;
+    stats->idle_time = cpu->idle_time;
+    return 0;
+}
+
+// Per-hart switch, steal and idle counters
+void sched_stats(void) {
+    for (int i = 0; i < MAX_HARTS; i++) {
+        struct cpu *cpu = &cpus[i];
+        if (!cpu->online) continue;
+        
+        printk("[sched] Hart %d: current %d, ready %d, switches %ld, steals %ld, idle %ld ticks, EDF %ld%%\n", 
+               i, cpu->current, cpu->nr_ready, cpu->switches, cpu->steals, cpu->idle_time, 
+               (cpu->edf_bw * 100) >> EDF_BW_SHIFT);
+    }
+}
+
+static void fill_task_stats(struct task *task, struct task_stats *s, unsigned long now) {
+    s->pid = task->pid;
+    s->state = task->state;
+    s->cpu = task->cpu;
+    s->priority = task->priority;
+    s->cycles = task->cycles;
+    s->run_time = task->run_time;
+    s->blocked_time = task->blocked_time;
+    s->voluntary_switches = task->nvcsw;
+    s->involuntary_switches = task->nivcsw;
+    s->msgs_sent = task->msgs_sent;
+    s->bytes_sent = task->bytes_sent;
+    s->msgs_recv = task->msgs_recv;
+    s->bytes_recv = task->bytes_recv;
+    s->deadline_misses = task->edf_misses;
+    
+    // Include the slice or wait in progress
+    if (task->state == TASK_RUNNING) {
+        s->run_time += now - task->run_start;
+    } else if (task->state == TASK_BLOCKED) {
+        s->blocked_time += now - task->block_start;
+    }
+    if (task->pid == current_task) {
+        s->cycles += cycles_now() - task->cycle_start;
+    }
+}
+
+// Snapshot the counters of every live task into stats (up to max entries).
+// Reads are unlocked: a concurrent switch can make one entry slightly stale,
+// never inconsistent enough to matter for a profile. Returns the count.
+int sched_task_stats(struct task_stats *stats, int max) {
+    if (!stats || max <= 0) return -1;
+    
+    unsigned long now = timer_now();
+    int count = 0;
+    
+    for (int i = 0; i < num_tasks && count < max; i++) {
+        if (tasks[i].state == TASK_UNUSED) continue;
+        fill_task_stats(&tasks[i], &stats[count++], now);
+    }
+    return count;
+}
+
+// top-style table of per-task CPU share and IPC traffic since boot. One
+// entry at a time, as a full snapshot would not fit on a task stack.
+void sched_top(void) {
+    static const char *state_names[] = { "unused", "run", "ready", "blocked" };
+    unsigned long now = timer_now();
+    struct task_stats s;
+    
+    unsigned long total = 0;
+    for (int i = 0; i < num_tasks; i++) {
+        if (tasks[i].state == TASK_UNUSED) continue;
+        fill_task_stats(&tasks[i], &s, now);
+        total += s.run_time;
+    }
+    if (total == 0) total = 1;
+    
+    // printk has no field widths, so columns are tab separated
+    printk("PID\tHART\tPRI\tSTATE\tCPU%%\tCYCLES\tRUN ms\tBLK ms\tVCSW\tIVCSW\tMSG TX/RX\tBYTES TX/RX\tMISS\n");
+    for (int i = 0; i < num_tasks; i++) {
+        if (tasks[i].state == TASK_UNUSED) continue;
+        fill_task_stats(&tasks[i], &s, now);
+        printk("%d\t%d\t%d\t%s\t%ld\t%ld\t%ld\t%ld\t%ld\t%ld\t%ld/%ld\t%ld/%ld\t%ld\n", 
+               s.pid, s.cpu, s.priority, state_names[s.state], 
+               s.run_time * 100 / total, s.cycles, 
+               s.run_time / MS_TO_TIMER_TICKS(1), s.blocked_time / MS_TO_TIMER_TICKS(1), 
+               s.voluntary_switches, s.involuntary_switches, 
+               s.msgs_sent, s.msgs_recv, s.bytes_sent, s.bytes_recv, s.deadline_misses);
+    }
+}
+
+// Budget enforcement for the running EDF task, on the timer interrupt
+// program_timer() armed for its exhaustion. Past its period it simply
+// starts the next instance (and its later deadline may let another task
+// in); otherwise it is throttled. Returns 1 if it was. Caller holds rq_lock.
+static int edf_enforce(struct cpu *cpu, struct task *task) {
+    unsigned long now = timer_now();
+    
+    edf_charge(task, now);
+    if (task->edf_budget > 0) return 0;
+    
+    if (now >= task->edf_next_period) {
+        edf_new_period(task, now);
+        cpu->need_resched = 1;
+        return 0;
+    }
+    task->state = TASK_BLOCKED;
+    task->block_start = now;
+    edf_throttle(task);
+    return 1;
+}
+
+// Timer interrupt: expire due kernel timers, enforce the running EDF
+// task's budget, then preempt the running task if its timeslice is over or
+// a timer woke something more urgent. The interrupt only fires with
+// interrupts on, so the task holds no spinlock and not the kernel lock; it
+// resumes later by returning through its trap frame. A hart in its idle
+// context is already looping on schedule().
+void sched_tick(void) {
+    struct cpu *cpu = this_cpu();
+    
+    ktimer_run();
+    
+    if (cpu->current >= 0 && tasks[cpu->current].edf_period) {
+        struct task *task = &tasks[cpu->current];
+        spin_lock(&cpu->rq_lock);
+        int throttled = edf_enforce(cpu, task);
+        spin_unlock(&cpu->rq_lock);
+        
+        if (throttled) {
+            edf_wait(task, SWITCH_PREEMPT);
+            return;
+        }
+    }
+    
+    // EDF tasks have no slice: they run until they block or use up their budget
+    if (cpu->current >= 0 && num_tasks > 1 &&
+        (cpu->need_resched || 
+         (!tasks[cpu->current].edf_period && timer_now() >= cpu->slice_end))) {
+        sched_preempt();
+        return;
+    }
+    
+    spin_lock(&cpu->rq_lock);
+    program_timer(cpu);
+    spin_unlock(&cpu->rq_lock);
+}
+
+// Another hart queued work here (see kick_cpu). Preempt if it outranks the
+// running task, otherwise re-arm the timer for the new queue. In the idle
+// context the idle loop picks it up as soon as the trap returns.
+void sched_ipi(void) {
+    struct cpu *cpu = this_cpu();
+    
+    if (cpu->current >= 0 && cpu->need_resched) {
+        sched_preempt();
+        return;
+    }
+    
+    spin_lock(&cpu->rq_lock);
+    program_timer(cpu);
+    spin_unlock(&cpu->rq_lock);
+}
@@ -1,8 +1,30 @@
 #ifndef SCHED_H
 #define SCHED_H
 
-#define MAX_TASKS 8
-#define TASK_STACK_SIZE 4096
+#include "ipc.h"
+#include "ktimer.h"
+
+// Task slots are reused once their task exits, so MAX_TASKS bounds live
+// tasks. Stacks are not part of the TCB: they come from the stack pool
+// (see stack_alloc() in mm.c), sized per task.
+#define MAX_TASKS 256
+#define TASK_STACK_SIZE 4096   // Default stack size
+
+// Priority levels, 0 = most urgent. Must fit the 32-bit ready bitmap.
+#define SCHED_PRIO_LEVELS  32
+#define SCHED_PRIO_SERVER  4   // Latency-critical servers
+#define SCHED_PRIO_DEFAULT 16
+#define SCHED_PRIO_IDLE    31  // Background filler tasks
+
+// EDF class: a task with a (runtime, period, deadline) reservation runs
+// ahead of every priority level, earliest absolute deadline first, and may
+// use at most runtime per period. Bandwidth is fixed point, EDF_BW_ONE
+// being a whole hart; admission keeps each hart at or below EDF_BW_MAX so
+// best-effort tasks always get the rest.
+#define EDF_BW_SHIFT   20
+#define EDF_BW_ONE     (1UL << EDF_BW_SHIFT)
+#define EDF_BW_MAX     (EDF_BW_ONE * 9 / 10)
+#define EDF_MAX_PERIOD (10UL * 10000000UL)  // 10 s in mtime ticks
 
 // Task states
 typedef enum {
@@ -12,6 +34,19 @@ typedef enum {
     TASK_BLOCKED
 } task_state_t;
 
+// Why a TASK_BLOCKED task is waiting
+typedef enum {
+    WAIT_NONE = 0,
+    WAIT_RECV,      // Waiting for a message in its IPC queue
+    WAIT_CALL,      // Client waiting for a server to take and answer its call
+    WAIT_CALLER,    // Server waiting in reply-and-wait for the next call
+    WAIT_NOTIFY,    // Waiting for notification bits in notify_wait_mask
+    WAIT_SEND,      // Sender waiting for credit on a full receiver queue
+    WAIT_SLEEP,     // Sleeping until wake_deadline
+    WAIT_CONSOLE,   // Waiting for UART input
+    WAIT_THROTTLED  // EDF task out of budget until edf_next_period
+} wait_reason_t;
+
 // Context structure for saving/restoring registers
 struct task_context {
     unsigned long ra;  // return address
@@ -34,24 +69,127 @@ struct task_context {
 struct task {
     int pid;
     task_state_t state;
+    int next_free;               // Link in the free slot list
+    int cpu;                     // Home hart; changes only when another hart steals the task
+    int on_cpu;                  // Context is live on a hart; it must not be stolen
+    int on_rq;                   // Linked into the home hart's ready queue
+    int next_ready, prev_ready;
+    unsigned long affinity;      // Harts the task may run on (bit per hart ID)
+    int priority;                // Effective: 0..SCHED_PRIO_LEVELS-1, lower runs first
+    int base_priority;           // Own priority, before inheritance
+    int pi_waiting_on;           // Task we lend our priority to while blocked (-1 = none)
+    int pi_waiters;              // Head of the tasks lending us theirs
+    int pi_next;                 // Link in the owner's pi_waiters list
+    wait_reason_t wait_reason;
+    unsigned long wake_deadline; // mtime at which a blocked task times out (0 = never)
+    struct ktimer wake_timer;    // Fires at wake_deadline on the home hart's wheel
     struct task_context context;
-    char stack[TASK_STACK_SIZE];
+    
+    // Call/reply fast path state
+    struct ipc_regs ipc_regs;    // Payload of an in-flight call or reply
+    int ipc_partner;             // Server we are calling (-1 once replied)
+    int handoff_hint;            // Receiver we last woke: run it next when we give up the CPU
+    int next_caller;             // Link in the server's caller queue (-2 once being served)
+    int caller_head, caller_tail; // Clients queued on this task as a server
+    int credit_wait_on;          // Receiver whose full queue we wait on (-1 = none)
+    int next_credit_waiter;      // Link in that receiver's credit wait list
+    
+    // Notification bits - set atomically, no message allocation
+    unsigned long notify_pending;
+    unsigned long notify_mask;      // Bits that also end a blocking receive
+    unsigned long notify_wait_mask; // Bits a WAIT_NOTIFY task is waiting for
+    
+    struct user_timer timers[TASK_TIMERS]; // SYS_TIMER_ARM slots
+    
+    // EDF reservation, all in mtime ticks; edf_period == 0 for best effort
+    unsigned long edf_runtime;      // Budget per period
+    unsigned long edf_period;
+    unsigned long edf_deadline;     // Relative deadline, <= edf_period
+    unsigned long edf_abs_deadline; // Deadline of the current instance
+    unsigned long edf_budget;       // Budget left in the current instance
+    unsigned long edf_next_period;  // When the budget is next replenished
+    unsigned long edf_run_start;    // Budget charged up to here while running
+    unsigned long edf_misses;       // Instances completed after their deadline
+    struct ktimer edf_timer;        // Replenishes a throttled task
+    
+    // Accounting for SYS_TASK_STATS; updated only by the task itself or by
+    // the hart switching it, so plain stores suffice
+    unsigned long cycles;        // rdcycle delta summed over completed runs
+    unsigned long cycle_start;   // rdcycle when last switched in
+    unsigned long run_time;      // mtime ticks on a hart
+    unsigned long run_start;     // mtime when last switched in
+    unsigned long blocked_time;  // mtime ticks spent TASK_BLOCKED
+    unsigned long block_start;   // mtime when it last blocked
+    unsigned long nvcsw;         // Voluntary switches (blocked, yielded, handed off)
+    unsigned long nivcsw;        // Involuntary switches (preempted)
+    unsigned long msgs_sent, bytes_sent;
+    unsigned long msgs_recv, bytes_recv;
+    
+    char *stack;                 // Stack base (guard words), 0 for kmain's boot stack
+    unsigned int stack_size;
 };
 
-// External assembly function
+// Snapshot of a task's counters for SYS_TASK_STATS. Times are in mtime
+// ticks (TIMER_FREQ_HZ); a running task's run_time includes its current
+// slice, its cycles only once it is switched out (or if it is the caller).
+struct task_stats {
+    int pid;
+    int state;
+    int cpu;
+    int priority;
+    unsigned long cycles;
+    unsigned long run_time;
+    unsigned long blocked_time;
+    unsigned long voluntary_switches;
+    unsigned long involuntary_switches;
+    unsigned long msgs_sent, bytes_sent;
+    unsigned long msgs_recv, bytes_recv;
+    unsigned long deadline_misses;  // EDF tasks only
+};
+
+struct hart_stats;
+
+// External assembly functions
 extern void context_switch(struct task_context *old, struct task_context *new);
+extern void task_trampoline(void);
 extern void set_trap_vector(void);
 
 // External variables
 extern struct task tasks[MAX_TASKS];
-extern int current_task;
-extern int num_tasks;
+extern int num_tasks;   // Slots ever used; live tasks are those not TASK_UNUSED
+
+// Per-hart state, including current_task
+#include "smp.h"
 
 // Function declarations
 void sched_init(void);
 void schedule(void);
+void schedule_to(int pid);
+void sched_preempt(void);
 void sched_tick(void);
+void sched_ipi(void);
 int create_task(void (*entry)(void));
+int create_task_stack(void (*entry)(void), unsigned int stack_size);
+void task_exit(void);
+void task_start(void);
 void task_yield(void);
+void yield_to(int pid);
+void task_block(wait_reason_t reason, unsigned long deadline);
+void task_block_handoff(wait_reason_t reason, int pid);
+void task_block_unless(wait_reason_t reason, unsigned long deadline, int (*ready)(void));
+void sleep_until(unsigned long deadline);
+void task_sleep_ms(int ms);
+void task_wakeup(int pid, wait_reason_t reason);
+int sched_set_affinity(int pid, unsigned long mask);
+int sched_set_priority(int pid, int priority);
+void pi_wait_on(int owner);
+void pi_release(int pid);
+int sched_set_edf(int pid, unsigned long runtime, unsigned long period, unsigned long deadline);
+void edf_yield(void);
+void sched_preempt_check(void);
+int sched_hart_stats(int hart, struct hart_stats *stats);
+void sched_stats(void);
+int sched_task_stats(struct task_stats *stats, int max);
+void sched_top(void);
 
 #endif
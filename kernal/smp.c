@@ -0,0 +1,190 @@
+#include "smp.h"
+#include "sched.h"
+#include "printk.h"
+#include "timer.h"
+
+struct cpu cpus[MAX_HARTS];
+int boot_hart = 0;
+int online_harts = 0;
+
+// Set by the boot hart to let parked secondaries in (boot/start.s)
+extern volatile int smp_release;
+extern void _start(void);
+
+static spinlock_t big_kernel_lock = SPINLOCK_INIT;
+static int kernel_lock_owner = -1;  // Task holding the lock
+static int kernel_lock_depth = 0;
+
+// SBI Hart State Management extension
+#define SBI_EXT_HSM        0x48534D
+#define SBI_HSM_HART_START 0
+
+// SBI IPI extension
+#define SBI_EXT_IPI      0x735049
+#define SBI_IPI_SEND_IPI 0
+
+static long sbi_hart_start(unsigned long hartid, unsigned long start_addr, unsigned long opaque) {
+    register unsigned long a0 asm("a0") = hartid;
+    register unsigned long a1 asm("a1") = start_addr;
+    register unsigned long a2 asm("a2") = opaque;
+    register unsigned long a6 asm("a6") = SBI_HSM_HART_START;
+    register unsigned long a7 asm("a7") = SBI_EXT_HSM;
+    asm volatile("ecall"
+                 : "+r"(a0), "+r"(a1)
+                 : "r"(a2), "r"(a6), "r"(a7)
+                 : "memory");
+    return (long)a0;
+}
+
+// Raise a supervisor software interrupt on hart (handled by sched_ipi())
+void smp_send_ipi(int hart) {
+    register unsigned long a0 asm("a0") = 1UL << hart;  // hart_mask
+    register unsigned long a1 asm("a1") = 0;            // hart_mask_base
+    register unsigned long a6 asm("a6") = SBI_IPI_SEND_IPI;
+    register unsigned long a7 asm("a7") = SBI_EXT_IPI;
+    asm volatile("ecall"
+                 : "+r"(a0), "+r"(a1)
+                 : "r"(a6), "r"(a7)
+                 : "memory");
+}
+
+// Point tp at this hart's struct cpu; current is the task already running
+// on it (-1 for a secondary sitting in its idle context)
+void cpu_init(int hartid, int current) {
+    struct cpu *cpu = &cpus[hartid];
+    
+    cpu->id = hartid;
+    cpu->current = current;
+    cpu->last = -1;
+    for (int prio = 0; prio < SCHED_PRIO_LEVELS; prio++) {
+        cpu->ready[prio].head = cpu->ready[prio].tail = -1;
+    }
+    cpu->ready_bitmap = 0;
+    cpu->edf_head = -1;
+    cpu->edf_bw = 0;
+    cpu->nr_ready = 0;
+    cpu->need_resched = 0;
+    cpu->switches = cpu->steals = cpu->idle_time = 0;
+    cpu->irq_depth = 0;
+    cpu->irq_enabled = 0;
+    cpu->in_trap = 0;
+    cpu->idle = 0;
+    cpu->timer_live = 0;
+    cpu->slice_end = 0;
+    cpu->timer_deadline = TIMER_NO_DEADLINE;
+    ktimer_wheel_init(hartid);
+    cpu->rq_lock.locked = 0;
+    
+    asm volatile("mv tp, %0" : : "r"(cpu));
+    
+    __atomic_store_n(&cpu->online, 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&online_harts, 1, __ATOMIC_SEQ_CST);
+}
+
+// Release the parked harts and wait for them to come online. Under OpenSBI
+// only the boot hart enters the kernel, so each secondary is started through
+// the HSM extension and lands in _start, where it parks until released.
+void smp_init(void) {
+    int started = 0;
+    
+    __atomic_store_n(&smp_release, 1, __ATOMIC_RELEASE);
+    
+    for (int hart = 0; hart < MAX_HARTS; hart++) {
+        if (hart == boot_hart) continue;
+        if (sbi_hart_start(hart, (unsigned long)_start, 0) == 0) {
+            started++;
+        }
+    }
+    
+    // Bounded wait: a hart that never shows up just stays offline
+    for (volatile int spin = 0; spin < 10000000; spin++) {
+        if (__atomic_load_n(&online_harts, __ATOMIC_ACQUIRE) >= started + 1) break;
+    }
+    
+    printk("[smp] %d hart(s) online (boot hart %d)\n", online_harts, boot_hart);
+}
+
+// Entry point of a released secondary hart, on its own boot stack. The hart
+// then idles, running whatever lands on or can be stolen into its queue and
+// sleeping in wfi (inside schedule()) when there is nothing.
+void secondary_main(unsigned long hartid) {
+    cpu_init((int)hartid, -1);
+    printk("[smp] Hart %d online\n", (int)hartid);
+    
+    set_trap_vector();
+    timer_init();
+    enable_interrupts();
+    
+    while (1) {
+        schedule();
+    }
+}
+
+#define SSTATUS_SIE (1UL << 1)
+
+// Disable interrupts on this hart, remembering whether they were on at the
+// outermost level. Nests, so each spinlock held adds one level.
+void irq_push_off(void) {
+    unsigned long sstatus;
+    asm volatile("csrrc %0, sstatus, %1" : "=r"(sstatus) : "r"(SSTATUS_SIE) : "memory");
+    
+    struct cpu *cpu = this_cpu();
+    if (cpu->irq_depth++ == 0) {
+        cpu->irq_enabled = (sstatus & SSTATUS_SIE) != 0;
+    }
+}
+
+void irq_pop_off(void) {
+    struct cpu *cpu = this_cpu();
+    if (--cpu->irq_depth == 0 && cpu->irq_enabled) {
+        asm volatile("csrs sstatus, %0" : : "r"(SSTATUS_SIE) : "memory");
+    }
+}
+
+void kernel_lock(void) {
+    // Interrupts off while reading current_task, so we cannot migrate mid-read
+    irq_push_off();
+    int self = current_task;
+    if (kernel_lock_owner == self) {
+        kernel_lock_depth++;
+        irq_pop_off();
+        return;
+    }
+    
+    spin_lock(&big_kernel_lock);
+    kernel_lock_owner = self;
+    kernel_lock_depth = 1;
+    irq_pop_off();
+}
+
+void kernel_unlock(void) {
+    if (--kernel_lock_depth > 0) return;
+    
+    kernel_lock_owner = -1;
+    spin_unlock(&big_kernel_lock);
+}
+
+// Release the lock entirely if the current task holds it, so it can be
+// switched out. Returns the depth to hand back to kernel_lock_restore().
+int kernel_lock_drop(void) {
+    irq_push_off();
+    if (kernel_lock_owner != current_task || current_task < 0) {
+        irq_pop_off();
+        return 0;
+    }
+    
+    int depth = kernel_lock_depth;
+    kernel_lock_depth = 0;
+    kernel_lock_owner = -1;
+    spin_unlock(&big_kernel_lock);
+    irq_pop_off();
+    return depth;
+}
+
+void kernel_lock_restore(int held) {
+    if (!held) return;
+    
+    spin_lock(&big_kernel_lock);
+    kernel_lock_owner = current_task;
+    kernel_lock_depth = held;
+}
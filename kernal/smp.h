@@ -0,0 +1,74 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include "spinlock.h"
+#include "sched.h"
+
+#define MAX_HARTS 8  // Must match HART_STACK_SIZE slices in boot/start.s
+
+// Per-hart state, reached through the tp register
+struct cpu {
+    int id;                            // Hart ID, also the index into cpus[]
+    int online;
+    int current;                       // Running task (-1 = the hart's idle context)
+    int last;                          // Task switched away from, until its context is saved
+    struct task_context idle_context;  // Boot stack context of a secondary hart
+    struct {
+        int head, tail;
+    } ready[SCHED_PRIO_LEVELS];        // FIFO per priority of READY tasks homed here
+    unsigned int ready_bitmap;         // Bit n set while ready[n] is non-empty
+    int edf_head;                      // READY EDF tasks homed here, earliest deadline first
+    unsigned long edf_bw;              // EDF bandwidth admitted here (EDF_BW_ONE = whole hart)
+    int nr_ready;
+    int need_resched;                  // A task that outranks current became ready
+    spinlock_t rq_lock;                // Guards the queue and its tasks' states
+    unsigned long switches;
+    unsigned long steals;              // Tasks taken from other harts' queues
+    unsigned long idle_time;           // mtime ticks asleep in wfi with nothing to run
+    int irq_depth;                     // Nesting of irq_push_off()
+    int irq_enabled;                   // Interrupt state before the outermost push
+    int in_trap;                       // Inside trap_handler()
+    int idle;                          // Asleep in wfi; wake with an IPI
+    int timer_live;                    // Timer interrupt enabled (timer_init done)
+    unsigned long slice_end;           // When the running task's timeslice ends
+    unsigned long timer_deadline;      // Currently armed timer deadline
+};
+
+// Snapshot of a hart's counters for SYS_HART_STATS
+struct hart_stats {
+    int online;
+    int current;
+    int nr_ready;
+    unsigned long switches;
+    unsigned long steals;
+    unsigned long idle_time;
+};
+
+extern struct cpu cpus[MAX_HARTS];
+extern int boot_hart;
+extern int online_harts;
+
+static inline struct cpu *this_cpu(void) {
+    struct cpu *cpu;
+    asm volatile("mv %0, tp" : "=r"(cpu));
+    return cpu;
+}
+
+// The task running on this hart
+#define current_task (this_cpu()->current)
+
+#define AFFINITY_ALL (~0UL)
+
+void cpu_init(int hartid, int current);
+void smp_init(void);
+void secondary_main(unsigned long hartid);
+void smp_send_ipi(int hart);
+
+// Big kernel lock: serialises syscalls across harts. task_block() and
+// task_yield() drop it while the holder is switched out.
+void kernel_lock(void);
+void kernel_unlock(void);
+int kernel_lock_drop(void);
+void kernel_lock_restore(int held);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+// Test-and-set spinlock. Holding one keeps interrupts off on this hart, so
+// the timer can never preempt a lock holder (see irq_push_off() in smp.c).
+typedef struct {
+    volatile int locked;
+} spinlock_t;
+
+#define SPINLOCK_INIT { 0 }
+
+void irq_push_off(void);
+void irq_pop_off(void);
+
+static inline void spin_lock(spinlock_t *lock) {
+    irq_push_off();
+    while (__atomic_test_and_set(&lock->locked, __ATOMIC_ACQUIRE)) {
+        // Spin on a plain load so waiting harts do not hammer the line with AMOs
+        while (__atomic_load_n(&lock->locked, __ATOMIC_RELAXED));
+    }
+}
+
+// Take the lock only if it is free; returns 1 on success
+static inline int spin_trylock(spinlock_t *lock) {
+    irq_push_off();
+    if (!__atomic_test_and_set(&lock->locked, __ATOMIC_ACQUIRE)) return 1;
+    irq_pop_off();
+    return 0;
+}
+
+static inline void spin_unlock(spinlock_t *lock) {
+    __atomic_clear(&lock->locked, __ATOMIC_RELEASE);
+    irq_pop_off();
+}
+
+#endif
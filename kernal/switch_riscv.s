@@ -1,5 +1,6 @@
 .section .text
 .global context_switch
+.global task_trampoline
 
 # context_switch(struct task_context *old, struct task_context *new)
 # a0 = old context pointer
@@ -38,3 +39,12 @@ context_switch:
     ld s11, 104(a1)
 
     ret
+
+# First code a new task runs: finish the switch that started it, then call
+# the entry point create_task() left in s0
+task_trampoline:
+    call task_start
+    jalr s0
+
+    # A task whose entry point returns exits, freeing its slot and stack
+    call task_exit
@@ -3,9 +3,9 @@
 #include "sched.h"
 #include "net_driver.h"
 #include "printk.h"
+#include "timer.h"
 
-// Handle system calls from user space
-long handle_syscall(long syscall_num, long arg1, long arg2, long arg3, long arg4) {
+static long do_syscall(long syscall_num, long arg1, long arg2, long arg3, long arg4) {
     switch (syscall_num) {
         case SYS_SEND_MSG:
             return send_message((int)arg1, (const void*)arg2, (int)arg3);
@@ -13,6 +13,49 @@ long handle_syscall(long syscall_num, long arg1, long arg2, long arg3, long arg4
         case SYS_RECV_MSG:
             return recv_message((int)arg1, (void*)arg2, (int)arg3);
             
+        case SYS_RECV_MSG_TIMEOUT:
+            return recv_message_timeout((int)arg1, (void*)arg2, (int)arg3, (int)arg4);
+            
+        case SYS_SEND_MSGV:
+            return send_message_vector((struct ipc_send_entry*)arg1, (int)arg2);
+            
+        case SYS_RECV_MSGV:
+            return recv_message_vector((int)arg1, (struct ipc_recv_entry*)arg2, (int)arg3, (int)arg4);
+            
+        case SYS_SET_QUEUE_DEPTH:
+            return ipc_set_queue_depth((int)arg1);
+            
+        case SYS_MULTICAST:
+            return multicast_message((const int*)arg1, (int)arg2, (const void*)arg3, (int)arg4);
+            
+        case SYS_CALL:
+            return call_message((int)arg1, (struct ipc_regs*)arg2);
+            
+        case SYS_REPLY_WAIT:
+            return reply_wait_message((int)arg1, (struct ipc_regs*)arg2);
+            
+        case SYS_GRANT_CREATE:
+            return grant_create((int)arg1, (void*)arg2, (int)arg3, (int)arg4);
+            
+        case SYS_GRANT_MAP:
+            return (long)grant_map((int)arg1, (int)arg2, (int*)arg3);
+            
+        case SYS_GRANT_REVOKE:
+            return grant_revoke((int)arg1);
+            
+        case SYS_NOTIFY:
+            return notify_signal((int)arg1, (unsigned long)arg2);
+            
+        case SYS_NOTIFY_WAIT:
+            return notify_wait((unsigned long)arg1, (int)arg2);
+            
+        case SYS_NOTIFY_MASK:
+            return notify_set_mask((unsigned long)arg1);
+            
+        case SYS_NET_RX_NOTIFY:
+            net_set_rx_notify(current_task, (unsigned long)arg1);
+            return SYSCALL_OK;
+            
         case SYS_NET_SEND:
             return net_send((const uint8_t*)arg1, (uint16_t)arg2);
             
@@ -37,15 +80,52 @@ long handle_syscall(long syscall_num, long arg1, long arg2, long arg3, long arg4
             task_yield();
             return SYSCALL_OK;
             
+        case SYS_YIELD_TO:
+            if (arg1 < 0 || arg1 >= num_tasks || tasks[arg1].state == TASK_UNUSED) {
+                return SYSCALL_ERROR;
+            }
+            yield_to((int)arg1);
+            return SYSCALL_OK;
+            
+        case SYS_SLEEP_UNTIL:
+            sleep_until((unsigned long)arg1);
+            return SYSCALL_OK;
+            
+        case SYS_TIMER_ARM:
+            return ktimer_user_arm((int)arg1, (unsigned long)arg2, (unsigned long)arg3);
+            
+        case SYS_TIMER_CANCEL:
+            return ktimer_user_cancel((int)arg1);
+            
         case SYS_CREATE_TASK:
-            return create_task((void (*)(void))arg1);
+            // arg2: stack size in bytes, 0 for the default
+            return create_task_stack((void (*)(void))arg1, 
+                                     arg2 ? (unsigned int)arg2 : TASK_STACK_SIZE);
+            
+        case SYS_SET_AFFINITY:
+            return sched_set_affinity((int)arg1, (unsigned long)arg2);
+            
+        case SYS_SET_PRIORITY:
+            return sched_set_priority((int)arg1, (int)arg2);
+            
+        case SYS_SCHED_EDF:
+            // Reservation in microseconds; arg4 0 = deadline at period end
+            return sched_set_edf((int)arg1, US_TO_TIMER_TICKS(arg2), 
+                                 US_TO_TIMER_TICKS(arg3), US_TO_TIMER_TICKS(arg4));
+            
+        case SYS_EDF_YIELD:
+            edf_yield();
+            return SYSCALL_OK;
+            
+        case SYS_HART_STATS:
+            return sched_hart_stats((int)arg1, (struct hart_stats*)arg2);
+            
+        case SYS_TASK_STATS:
+            return sched_task_stats((struct task_stats*)arg1, (int)arg2);
             
         case SYS_EXIT:
-            // Mark current task as unused
-            if (current_task >= 0 && current_task < MAX_TASKS) {
-                tasks[current_task].state = TASK_UNUSED;
-                task_yield(); // Switch to another task
-            }
+            // Frees the task's slot and stack for reuse; does not return
+            task_exit();
             return SYSCALL_OK;
             
         default:
@@ -53,3 +133,16 @@ long handle_syscall(long syscall_num, long arg1, long arg2, long arg3, long arg4
             return SYSCALL_ERROR;
     }
 }
+
+// Handle system calls from user space. Each call runs under the big kernel
+// lock, so IPC and driver state are touched by one hart at a time; blocking
+// calls drop it while they sleep.
+long handle_syscall(long syscall_num, long arg1, long arg2, long arg3, long arg4) {
+    kernel_lock();
+    long result = do_syscall(syscall_num, arg1, arg2, arg3, arg4);
+    kernel_unlock();
+    
+    // A wakeup in this call may have readied a more urgent task
+    sched_preempt_check();
+    return result;
+}
@@ -10,6 +10,30 @@
 #define SYS_YIELD       6
 #define SYS_CREATE_TASK 7
 #define SYS_EXIT        8
+#define SYS_RECV_MSG_TIMEOUT 9
+#define SYS_CALL        10
+#define SYS_REPLY_WAIT  11
+#define SYS_GRANT_CREATE 12
+#define SYS_GRANT_MAP   13
+#define SYS_GRANT_REVOKE 14
+#define SYS_NOTIFY      15
+#define SYS_NOTIFY_WAIT 16
+#define SYS_NOTIFY_MASK 17
+#define SYS_NET_RX_NOTIFY 18
+#define SYS_SEND_MSGV   19
+#define SYS_RECV_MSGV   20
+#define SYS_SET_QUEUE_DEPTH 21
+#define SYS_MULTICAST   22
+#define SYS_SET_AFFINITY 23
+#define SYS_HART_STATS  24
+#define SYS_SET_PRIORITY 25
+#define SYS_SLEEP_UNTIL 26
+#define SYS_TIMER_ARM   27
+#define SYS_TIMER_CANCEL 28
+#define SYS_TASK_STATS  29
+#define SYS_YIELD_TO    30
+#define SYS_SCHED_EDF   31
+#define SYS_EDF_YIELD   32
 
 // System call return values
 #define SYSCALL_OK      0
@@ -25,14 +49,46 @@ struct syscall_args {
     long result;
 };
 
+struct ipc_regs;
+struct ipc_send_entry;
+struct ipc_recv_entry;
+struct hart_stats;
+struct task_stats;
+
 // System call functions for user-space
 int syscall_send_msg(int receiver_pid, const void *data, int size);
 int syscall_recv_msg(int sender_pid, void *buffer, int max_size);
+int syscall_recv_msg_timeout(int sender_pid, void *buffer, int max_size, int timeout_ms);
+int syscall_send_msgv(struct ipc_send_entry *entries, int count);
+int syscall_recv_msgv(int sender_pid, struct ipc_recv_entry *entries, int count, int timeout_ms);
+int syscall_set_queue_depth(int depth);
+int syscall_multicast(const int *receivers, int count, const void *data, int size);
+int syscall_call(int server_pid, struct ipc_regs *regs);
+int syscall_reply_wait(int reply_to, struct ipc_regs *regs);
+int syscall_grant_create(int grantee_pid, void *base, int size, int flags);
+void *syscall_grant_map(int handle, int flags, int *size);
+int syscall_grant_revoke(int handle);
+int syscall_notify(int pid, unsigned long bits);
+unsigned long syscall_notify_wait(unsigned long mask, int timeout_ms);
+unsigned long syscall_notify_mask(unsigned long mask);
+int syscall_net_rx_notify(unsigned long bits);
 int syscall_net_send(const void *data, int size);
 int syscall_net_recv(void *buffer, int max_size);
 int syscall_get_pid(void);
+int syscall_set_affinity(int pid, unsigned long mask);
+int syscall_set_priority(int pid, int priority);
+int syscall_sched_edf(int pid, unsigned long runtime_us, unsigned long period_us, unsigned long deadline_us);
+void syscall_edf_yield(void);
+int syscall_hart_stats(int hart, struct hart_stats *stats);
+int syscall_task_stats(struct task_stats *stats, int max);
 void syscall_yield(void);
+int syscall_yield_to(int pid);
+int syscall_sleep_until(unsigned long deadline);
+int syscall_sleep_ms(int ms);
+int syscall_timer_arm(int id, unsigned long deadline, unsigned long bits);
+int syscall_timer_cancel(int id);
 int syscall_create_task(void (*entry_point)(void));
+int syscall_create_task_stack(void (*entry_point)(void), unsigned int stack_size);
 void syscall_exit(void);
 
 #endif
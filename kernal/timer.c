@@ -1,118 +1,165 @@
 #include "printk.h"
 #include "sched.h"
 #include "uart.h"
+#include "timer.h"
+#include "plic.h"
 
-// RISC-V trap causes
-#define CAUSE_TIMER_INTERRUPT 0x8000000000000007UL
-#define CAUSE_ECALL_FROM_M    0x000000000000000BUL
-#define CAUSE_UART_INTERRUPT  0x8000000000000009UL
+// RISC-V trap causes (supervisor mode: OpenSBI owns M-mode)
+#define CAUSE_INTERRUPT        0x8000000000000000UL
+#define CAUSE_SOFT_INTERRUPT   0x8000000000000001UL
+#define CAUSE_TIMER_INTERRUPT  0x8000000000000005UL
+#define CAUSE_EXT_INTERRUPT    0x8000000000000009UL
+#define CAUSE_ECALL_FROM_S     0x0000000000000009UL
 
-// CLINT (Core Local Interruptor) registers for QEMU virt machine
-#define CLINT_BASE 0x2000000UL
-#define CLINT_MTIMECMP(hart) (CLINT_BASE + 0x4000 + 8 * (hart))
-#define CLINT_MTIME (CLINT_BASE + 0xBFF8)
+#define SIE_SSIE    (1UL << 1)
+#define SIE_STIE    (1UL << 5)
+#define SIE_SEIE    (1UL << 9)
+#define SIP_SSIP    (1UL << 1)
+#define SSTATUS_SIE (1UL << 1)
 
-// Timer interval (approximately 100ms at 10MHz)
-#define TIMER_INTERVAL 1000000
+// SBI Timer extension: programs this hart's mtimecmp on our behalf
+#define SBI_EXT_TIME      0x54494D45
+#define SBI_TIME_SET_TIMER 0
 
 static unsigned long timer_ticks = 0;
 
-// Read from memory-mapped register
-static inline unsigned long read_reg(unsigned long addr) {
-    return *(volatile unsigned long *)addr;
+static void sbi_set_timer(unsigned long deadline) {
+    register unsigned long a0 asm("a0") = deadline;
+    register unsigned long a6 asm("a6") = SBI_TIME_SET_TIMER;
+    register unsigned long a7 asm("a7") = SBI_EXT_TIME;
+    asm volatile("ecall"
+                 : "+r"(a0)
+                 : "r"(a6), "r"(a7)
+                 : "a1", "memory");
 }
 
-// Write to memory-mapped register
-static inline void write_reg(unsigned long addr, unsigned long value) {
-    *(volatile unsigned long *)addr = value;
-}
-
-// Enable machine timer interrupt
+// Enable the supervisor timer interrupt on this hart. Each hart calls this
+// once; interrupts stay masked until enable_interrupts(). There is no
+// periodic tick: nothing is armed until the scheduler asks for a deadline.
 void timer_init(void) {
-    // Set initial timer compare value (far in future to prevent immediate interrupts)
-    unsigned long current_time = read_reg(CLINT_MTIME);
-    write_reg(CLINT_MTIMECMP(0), current_time + (TIMER_INTERVAL * 10)); // Start with longer delay
+    struct cpu *cpu = this_cpu();
     
-    // Enable machine timer interrupt in mie
-    unsigned long mie;
-    asm volatile("csrr %0, mie" : "=r"(mie));
-    mie |= (1UL << 7); // Set MTIE bit (bit 7)
-    asm volatile("csrw mie, %0" : : "r"(mie));
+    cpu->timer_deadline = TIMER_NO_DEADLINE;
+    sbi_set_timer(TIMER_NO_DEADLINE);
+    asm volatile("csrs sie, %0" : : "r"(SIE_STIE));
+    cpu->timer_live = 1;
     
-    // Don't enable global interrupts yet - wait until system is fully initialized
+    if (cpu->id == boot_hart) {
+        printk("[timer] Tickless timer initialized\n");
+    }
+}
+
+// Arm this hart's timer for an mtime deadline (TIMER_NO_DEADLINE disarms).
+// Skips the SBI call when the deadline is already armed.
+void timer_set_deadline(unsigned long deadline) {
+    struct cpu *cpu = this_cpu();
     
-    printk("[timer] Timer initialized with %d tick interval\n", TIMER_INTERVAL);
+    if (deadline == cpu->timer_deadline) return;
+    cpu->timer_deadline = deadline;
+    sbi_set_timer(deadline);
 }
 
-// Function to enable interrupts after full system initialization
+// Function to enable interrupts on this hart after initialization:
+// timer, IPIs and external (PLIC) interrupts
 void enable_interrupts(void) {
-    // Set proper timer compare value
-    unsigned long current_time = read_reg(CLINT_MTIME);
-    write_reg(CLINT_MTIMECMP(0), current_time + TIMER_INTERVAL);
-    
-    // Enable global interrupts in mstatus
-    asm volatile("csrsi mstatus, 0x8"); // Set MIE bit (bit 3)
+    asm volatile("csrs sie, %0" : : "r"(SIE_SSIE | SIE_SEIE));
+    asm volatile("csrs sstatus, %0" : : "r"(SSTATUS_SIE));
     
-    printk("[timer] Interrupts enabled\n");
+    if (this_cpu()->id == boot_hart) {
+        printk("[timer] Interrupts enabled\n");
+    }
 }
 
-// Main trap handler called from assembly
-void trap_handler(unsigned long cause, unsigned long epc, unsigned long tval) {
-    // Add debug output to see what traps are occurring
-    static int trap_count = 0;
-    static int in_trap = 0;
+// Main trap handler called from trap_entry with the saved frame
+void trap_handler(struct trap_frame *frame) {
+    struct cpu *cpu = this_cpu();
+    unsigned long cause = frame->scause;
     
-    // Prevent recursive traps
-    if (in_trap) {
-        printk("[trap] ERROR: Recursive trap detected!\n");
-        asm volatile("csrci mstatus, 0x8"); // Disable interrupts
-        while(1); // Halt
+    // A trap while handling a trap means the handler itself faulted
+    if (cpu->in_trap) {
+        printk("[trap] ERROR: Recursive trap on hart %d: cause=0x%lx, epc=0x%lx\n",
+               cpu->id, cause, frame->sepc);
+        while (1);
     }
-    
-    in_trap = 1;
-    trap_count++;
+    cpu->in_trap = 1;
     
     if (cause == CAUSE_TIMER_INTERRUPT) {
-        // Handle timer interrupt
-        timer_ticks++;
-        
-        // Set next timer interrupt
-        unsigned long current_time = read_reg(CLINT_MTIME);
-        write_reg(CLINT_MTIMECMP(0), current_time + TIMER_INTERVAL);
+        // Disarm to clear the pending interrupt; the scheduler arms the
+        // next deadline on its way out
+        timer_set_deadline(TIMER_NO_DEADLINE);
         
-        // Limit debug output to prevent spam
-        if (timer_ticks % 10 == 0) {
-            printk("[trap] Timer tick %lu\n", timer_ticks);
+        unsigned long ticks = __atomic_add_fetch(&timer_ticks, 1, __ATOMIC_RELAXED);
+        if (ticks % 1000 == 0) {
+            printk("[trap] Timer tick %lu\n", ticks);
         }
         
-        // Call scheduler tick
+        // Clear the flag before sched_tick() may switch away: the next trap
+        // on this hart can belong to a different task
+        cpu->in_trap = 0;
         sched_tick();
+        return;
+    }
+    
+    if (cause == CAUSE_SOFT_INTERRUPT) {
+        asm volatile("csrc sip, %0" : : "r"(SIP_SSIP));
+        cpu->in_trap = 0;
+        sched_ipi();
+        return;
     }
-    else if (cause == CAUSE_ECALL_FROM_M) {
-        // Handle ECALL (system call)
-        printk("[trap] ECALL from M-mode at 0x%lx\n", epc);
-        // Increment mepc to skip the ecall instruction
-        asm volatile("csrw mepc, %0" : : "r"(epc + 4));
+    
+    if (cause == CAUSE_ECALL_FROM_S) {
+        // Syscalls are plain calls; a stray ecall is skipped
+        printk("[trap] ECALL from S-mode at 0x%lx\n", frame->sepc);
+        frame->sepc += 4;
     }
-    else if ((cause & 0x8000000000000000UL) && ((cause & 0xFF) == 9)) {
+    else if (cause == CAUSE_EXT_INTERRUPT) {
         // Handle external interrupt (UART)
-        uart_interrupt_handler();
+        int irq = plic_claim();
+        if (irq == UART0_IRQ) {
+            uart_interrupt_handler();
+        }
+        if (irq) plic_complete(irq);
+    }
+    else if (cause & CAUSE_INTERRUPT) {
+        // Nothing services it: mask the source so it cannot storm
+        unsigned long bit = 1UL << (cause & 0x3F);
+        asm volatile("csrc sie, %0" : : "r"(bit));
+        asm volatile("csrc sip, %0" : : "r"(bit));
+        printk("[trap] Masked unexpected interrupt: cause=0x%lx\n", cause);
     }
     else {
-        // Handle other traps
-        printk("[trap] Unhandled trap #%d: cause=0x%lx, epc=0x%lx, tval=0x%lx\n", 
-               trap_count, cause, epc, tval);
-        
-        // If we get too many unknown traps, something is wrong
-        if (trap_count > 10) {
-            printk("[trap] Too many unknown traps, disabling interrupts\n");
-            asm volatile("csrci mstatus, 0x8"); // Clear MIE bit
-        }
+        // Returning would re-execute the faulting instruction forever
+        printk("[trap] Unhandled exception on hart %d: cause=0x%lx, epc=0x%lx, tval=0x%lx\n", 
+               cpu->id, cause, frame->sepc, frame->stval);
+        printk("[trap] Halting hart %d\n", cpu->id);
+        while (1);
     }
     
-    in_trap = 0;
+    cpu->in_trap = 0;
+    
+    // A wakeup from the handler may have readied a more urgent task
+    if (cpu->current >= 0 && cpu->need_resched) {
+        sched_preempt();
+    }
 }
 
 unsigned long get_timer_ticks(void) {
     return timer_ticks;
 }
+
+// Current mtime value (readable even with timer interrupts disabled). The
+// CLINT itself is M-mode only under OpenSBI, so go through the time CSR.
+unsigned long timer_now(void) {
+    unsigned long now;
+    asm volatile("rdtime %0" : "=r"(now));
+    return now;
+}
+
+// This hart's cycle counter. OpenSBI opens it to S-mode via mcounteren; the
+// counters of different harts are not synchronised, so only compare values
+// read on the same hart.
+unsigned long cycles_now(void) {
+    unsigned long cycles;
+    asm volatile("rdcycle %0" : "=r"(cycles));
+    return cycles;
+}
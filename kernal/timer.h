@@ -1,9 +1,28 @@
 #ifndef TIMER_H
 #define TIMER_H
 
+// mtime frequency on the QEMU virt machine (10MHz), read through the time CSR
+#define TIMER_FREQ_HZ 10000000UL
+#define MS_TO_TIMER_TICKS(ms) ((unsigned long)(ms) * (TIMER_FREQ_HZ / 1000))
+#define US_TO_TIMER_TICKS(us) ((unsigned long)(us) * (TIMER_FREQ_HZ / 1000000))
+#define TIMER_NO_DEADLINE (~0UL)
+
+// Registers saved by trap_entry (trap_riscv.s); the layout must match its offsets
+struct trap_frame {
+    unsigned long regs[31];  // x1..x31; regs[1] is the interrupted sp
+    unsigned long sepc;
+    unsigned long sstatus;
+    unsigned long scause;
+    unsigned long stval;
+    unsigned long pad;
+};
+
 void timer_init(void);
+void timer_set_deadline(unsigned long deadline);
 void enable_interrupts(void);
-void trap_handler(unsigned long cause, unsigned long epc, unsigned long tval);
+void trap_handler(struct trap_frame *frame);
 unsigned long get_timer_ticks(void);
+unsigned long timer_now(void);
+unsigned long cycles_now(void);
 
 #endif
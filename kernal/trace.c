@@ -0,0 +1,41 @@
+#include "trace.h"
+#include "printk.h"
+
+struct trace_record trace_ring[TRACE_RING_SIZE];
+unsigned long trace_head = 0;
+
+static const char *trace_event_name(int event) {
+    switch (event) {
+        case TRACE_IPC_SEND:    return "SEND";
+        case TRACE_IPC_RECV:    return "RECV";
+        case TRACE_IPC_EMPTY:   return "EMPTY";
+        case TRACE_IPC_BLOCK:   return "BLOCK";
+        case TRACE_IPC_TIMEOUT: return "TIMEOUT";
+        case TRACE_IPC_CALL:    return "CALL";
+        case TRACE_IPC_REPLY:   return "REPLY";
+        case TRACE_IPC_THROTTLE: return "THROTTLE";
+        case TRACE_IPC_MCAST:   return "MCAST";
+        default:                return "?";
+    }
+}
+
+// Print the buffered records, oldest first
+void trace_dump(void) {
+    unsigned long start = 0;
+    if (trace_head > TRACE_RING_SIZE) {
+        start = trace_head - TRACE_RING_SIZE;
+    }
+    
+    printk("[trace] %ld records (%ld dropped)\n", trace_head - start, start);
+    
+    for (unsigned long i = start; i < trace_head; i++) {
+        struct trace_record *rec = &trace_ring[i & (TRACE_RING_SIZE - 1)];
+        printk("[trace] %ld %s %d -> %d size=%d depth=%d\n",
+               rec->timestamp, trace_event_name(rec->event),
+               rec->src, rec->dst, rec->size, rec->depth);
+    }
+}
+
+void trace_reset(void) {
+    trace_head = 0;
+}
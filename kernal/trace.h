@@ -0,0 +1,48 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "timer.h"
+
+// Binary trace ring for hot paths that cannot afford printk.
+// Records are fixed-size and overwritten oldest-first; trace_dump() prints them.
+
+#define TRACE_RING_SIZE 256  // Must be a power of two
+
+// Trace events
+#define TRACE_IPC_SEND     1  // Message queued (depth = receiver queue depth)
+#define TRACE_IPC_RECV     2  // Message dequeued (depth = remaining queue depth)
+#define TRACE_IPC_EMPTY    3  // Non-blocking receive found the queue empty
+#define TRACE_IPC_BLOCK    4  // Receiver blocked on an empty queue
+#define TRACE_IPC_TIMEOUT  5  // Blocking receive or credit wait timed out
+#define TRACE_IPC_CALL     6  // Fast-path call issued
+#define TRACE_IPC_REPLY    7  // Fast-path reply delivered
+#define TRACE_IPC_THROTTLE 8  // Sender blocked on a full queue (depth = queue depth)
+#define TRACE_IPC_MCAST    9  // Multicast sent (depth = receivers reached)
+
+struct trace_record {
+    unsigned long timestamp;  // CLINT mtime
+    unsigned short event;
+    short src;
+    short dst;
+    unsigned short size;
+    unsigned int depth;
+};
+
+extern struct trace_record trace_ring[TRACE_RING_SIZE];
+extern unsigned long trace_head;  // Total records ever written
+
+static inline void trace_event(int event, int src, int dst, int size, int depth) {
+    struct trace_record *rec = &trace_ring[trace_head & (TRACE_RING_SIZE - 1)];
+    rec->timestamp = timer_now();
+    rec->event = event;
+    rec->src = src;
+    rec->dst = dst;
+    rec->size = size;
+    rec->depth = depth;
+    trace_head++;
+}
+
+void trace_dump(void);
+void trace_reset(void);
+
+#endif
@@ -2,55 +2,111 @@
 .global trap_entry
 .global set_trap_vector
 
-# Set up the trap vector
+# Trap frame layout, must match struct trap_frame in timer.h:
+# x1..x31 at (n-1)*8, then sepc, sstatus, scause, stval
+.equ TF_SEPC,    248
+.equ TF_SSTATUS, 256
+.equ TF_SCAUSE,  264
+.equ TF_STVAL,   272
+.equ TF_SIZE,    288   # Keeps sp 16-byte aligned
+
+# Set up the trap vector for this hart (direct mode)
 set_trap_vector:
     la t0, trap_entry
-    csrw mtvec, t0
+    csrw stvec, t0
     ret
 
+# The kernel and its tasks all run in S-mode, so a trap always arrives on a
+# valid kernel stack: the interrupted task's own stack, or a hart's boot
+# stack in its idle context. The full frame lives there, which lets the
+# handler switch tasks and resume this one later by returning through it.
+.align 2
 trap_entry:
-    # Save caller-saved registers
-    addi sp, sp, -256
-    sd ra, 0(sp)
+    addi sp, sp, -TF_SIZE
+    sd x1, 0(sp)
+    sd x3, 16(sp)
+    sd x4, 24(sp)
+    sd x5, 32(sp)
+    sd x6, 40(sp)
+    sd x7, 48(sp)
+    sd x8, 56(sp)
+    sd x9, 64(sp)
+    sd x10, 72(sp)
+    sd x11, 80(sp)
+    sd x12, 88(sp)
+    sd x13, 96(sp)
+    sd x14, 104(sp)
+    sd x15, 112(sp)
+    sd x16, 120(sp)
+    sd x17, 128(sp)
+    sd x18, 136(sp)
+    sd x19, 144(sp)
+    sd x20, 152(sp)
+    sd x21, 160(sp)
+    sd x22, 168(sp)
+    sd x23, 176(sp)
+    sd x24, 184(sp)
+    sd x25, 192(sp)
+    sd x26, 200(sp)
+    sd x27, 208(sp)
+    sd x28, 216(sp)
+    sd x29, 224(sp)
+    sd x30, 232(sp)
+    sd x31, 240(sp)
+
+    # Interrupted sp, then the CSRs a later trap on this hart would clobber
+    addi t0, sp, TF_SIZE
     sd t0, 8(sp)
-    sd t1, 16(sp)
-    sd t2, 24(sp)
-    sd a0, 32(sp)
-    sd a1, 40(sp)
-    sd a2, 48(sp)
-    sd a3, 56(sp)
-    sd a4, 64(sp)
-    sd a5, 72(sp)
-    sd a6, 80(sp)
-    sd a7, 88(sp)
-    sd t3, 96(sp)
-    sd t4, 104(sp)
-    sd t5, 112(sp)
-    sd t6, 120(sp)
-
-    # Call C trap handler
-    csrr a0, mcause
-    csrr a1, mepc
-    csrr a2, mtval
+    csrr t0, sepc
+    sd t0, TF_SEPC(sp)
+    csrr t0, sstatus
+    sd t0, TF_SSTATUS(sp)
+    csrr t0, scause
+    sd t0, TF_SCAUSE(sp)
+    csrr t0, stval
+    sd t0, TF_STVAL(sp)
+
+    # Call C trap handler with the frame
+    mv a0, sp
     call trap_handler
 
-    # Restore caller-saved registers
-    ld ra, 0(sp)
-    ld t0, 8(sp)
-    ld t1, 16(sp)
-    ld t2, 24(sp)
-    ld a0, 32(sp)
-    ld a1, 40(sp)
-    ld a2, 48(sp)
-    ld a3, 56(sp)
-    ld a4, 64(sp)
-    ld a5, 72(sp)
-    ld a6, 80(sp)
-    ld a7, 88(sp)
-    ld t3, 96(sp)
-    ld t4, 104(sp)
-    ld t5, 112(sp)
-    ld t6, 120(sp)
-    addi sp, sp, 256
-
-    mret
+    # Back on the interrupted task, perhaps much later and on another hart.
+    # Interrupts are off here; sret re-enables them from SPIE.
+    ld t0, TF_SEPC(sp)
+    csrw sepc, t0
+    ld t0, TF_SSTATUS(sp)
+    csrw sstatus, t0
+
+    # tp is not restored: it always points at the current hart's struct cpu
+    ld x1, 0(sp)
+    ld x3, 16(sp)
+    ld x5, 32(sp)
+    ld x6, 40(sp)
+    ld x7, 48(sp)
+    ld x8, 56(sp)
+    ld x9, 64(sp)
+    ld x10, 72(sp)
+    ld x11, 80(sp)
+    ld x12, 88(sp)
+    ld x13, 96(sp)
+    ld x14, 104(sp)
+    ld x15, 112(sp)
+    ld x16, 120(sp)
+    ld x17, 128(sp)
+    ld x18, 136(sp)
+    ld x19, 144(sp)
+    ld x20, 152(sp)
+    ld x21, 160(sp)
+    ld x22, 168(sp)
+    ld x23, 176(sp)
+    ld x24, 184(sp)
+    ld x25, 192(sp)
+    ld x26, 200(sp)
+    ld x27, 208(sp)
+    ld x28, 216(sp)
+    ld x29, 224(sp)
+    ld x30, 232(sp)
+    ld x31, 240(sp)
+    addi sp, sp, TF_SIZE
+
+    sret
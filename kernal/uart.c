@@ -1,4 +1,6 @@
 #include "uart.h"
+#include "plic.h"
+#include "sched.h"
 
 #define UART0_BASE 0x10000000UL   // QEMU virt machine UART0 (NS16550A)
 #define UART_THR   0x00           // Transmit Holding Reg
@@ -14,6 +16,8 @@ static char input_buffer[UART_BUFFER_SIZE];
 static volatile int buffer_head = 0;
 static volatile int buffer_tail = 0;
 static volatile int buffer_count = 0;
+static spinlock_t input_lock = SPINLOCK_INIT;  // Also keeps the IRQ off this hart
+static int console_waiter = -1;               // Task sleeping in uart_wait_input()
 
 static inline void write_reg(unsigned long addr, unsigned char value) {
     *(volatile unsigned char *)(UART0_BASE + addr) = value;
@@ -29,8 +33,9 @@ void uart_init(void) {
     buffer_tail = 0;
     buffer_count = 0;
     
-    // Enable receive data interrupt
+    // Enable receive data interrupt, delivered to this (the boot) hart
     write_reg(UART_IER, UART_IER_RDI);
+    plic_enable(UART0_IRQ, this_cpu()->id);
 }
 
 void uart_putc(char c) {
@@ -46,17 +51,32 @@ void uart_putc(char c) {
 
 char uart_getc(void) {
     // Read from interrupt-driven buffer
+    spin_lock(&input_lock);
     if (buffer_count == 0) {
+        spin_unlock(&input_lock);
         return 0; // No data available
     }
     
     char c = input_buffer[buffer_tail];
     buffer_tail = (buffer_tail + 1) % UART_BUFFER_SIZE;
     buffer_count--;
+    spin_unlock(&input_lock);
     
     return c;
 }
 
+// Block the calling task until input is buffered; the hart can idle
+// meanwhile. The RX interrupt wakes the waiter.
+void uart_wait_input(void) {
+    irq_push_off();
+    console_waiter = current_task;
+    irq_pop_off();
+    
+    while (!uart_has_data()) {
+        task_block_unless(WAIT_CONSOLE, 0, uart_has_data);
+    }
+}
+
 void uart_puts(const char *s) {
     while (*s) {
         uart_putc(*s++);
@@ -68,6 +88,8 @@ int uart_has_data(void) {
 }
 
 void uart_interrupt_handler(void) {
+    spin_lock(&input_lock);
+    
     // Check if data is available
     while (read_reg(UART_LSR) & UART_LSR_DR) {
         char c = read_reg(UART_RBR);
@@ -80,4 +102,11 @@ void uart_interrupt_handler(void) {
         }
         // If buffer is full, drop the character (or could overwrite oldest)
     }
+    
+    int waiter = console_waiter;
+    spin_unlock(&input_lock);
+    
+    if (waiter >= 0 && buffer_count > 0) {
+        task_wakeup(waiter, WAIT_CONSOLE);
+    }
 }
@@ -8,6 +8,7 @@ void uart_putc(char c);
 char uart_getc(void);
 void uart_puts(const char *s);
 int uart_has_data(void);
+void uart_wait_input(void);
 void uart_interrupt_handler(void);
 
 #endif
@@ -31,6 +31,8 @@ void exit_process(void);
 // IPC functions
 int ipc_send_message(pid_t receiver, int msg_type, const void *data, size_t size);
 int ipc_receive_message(pid_t sender, int *msg_type, void *buffer, size_t max_size);
+// Requests and responses of up to IPC_FAST_WORDS words use SYS_CALL, so the
+// server must answer those with SYS_REPLY_WAIT
 int send_request(pid_t server, const void *request, size_t req_size, 
                  void *response, size_t max_resp_size);
 
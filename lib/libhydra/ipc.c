@@ -1,4 +1,5 @@
 #include "hydra.h"
+#include "../../kernal/ipc.h"
 
 // Forward declarations for syscalls
 extern int syscall_get_pid(void);
@@ -7,6 +8,7 @@ extern void syscall_yield(void);
 extern void syscall_exit(void);
 extern int syscall_send_msg(int receiver_pid, const void *data, int size);
 extern int syscall_recv_msg(int sender_pid, void *buffer, int max_size);
+extern int syscall_call(int server_pid, struct ipc_regs *regs);
 
 // Process management functions
 
@@ -68,8 +70,38 @@ int ipc_receive_message(pid_t sender, int *msg_type, void *buffer, size_t max_si
     return result;
 }
 
+// Request/response pairs that fit in the message registers go through one
+// SYS_CALL, which switches straight to the server and back; larger ones fall
+// back to a request message plus a selective receive for the response.
 int send_request(pid_t server, const void *request, size_t req_size, 
                  void *response, size_t max_resp_size) {
+    const size_t fast_bytes = IPC_FAST_WORDS * sizeof(unsigned long);
+    
+    if (req_size <= fast_bytes && max_resp_size <= fast_bytes) {
+        struct ipc_regs regs;
+        char *dst = (char *)regs.mr;
+        const char *src = (const char *)request;
+        for (size_t i = 0; i < req_size; i++) {
+            dst[i] = src[i];
+        }
+        regs.count = (req_size + sizeof(unsigned long) - 1) / sizeof(unsigned long);
+        
+        if (syscall_call(server, &regs) < 0) {
+            return -1;
+        }
+        
+        size_t resp_size = regs.count * sizeof(unsigned long);
+        if (resp_size > max_resp_size) {
+            resp_size = max_resp_size;
+        }
+        src = (const char *)regs.mr;
+        dst = (char *)response;
+        for (size_t i = 0; i < resp_size; i++) {
+            dst[i] = src[i];
+        }
+        return resp_size;
+    }
+    
     // Send request
     int result = ipc_send_message(server, MSG_TYPE_REQUEST, request, req_size);
     if (result < 0) {
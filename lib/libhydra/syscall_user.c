@@ -1,4 +1,5 @@
 #include "../../kernal/syscall.h"
+#include "../../kernal/timer.h"
 #include <stddef.h>
 
 // Simple system call wrapper - for now we'll use direct function calls
@@ -19,6 +20,62 @@ int syscall_recv_msg(int sender_pid, void *buffer, int max_size) {
     return handle_syscall(SYS_RECV_MSG, sender_pid, (long)buffer, max_size, 0);
 }
 
+int syscall_recv_msg_timeout(int sender_pid, void *buffer, int max_size, int timeout_ms) {
+    return handle_syscall(SYS_RECV_MSG_TIMEOUT, sender_pid, (long)buffer, max_size, timeout_ms);
+}
+
+int syscall_send_msgv(struct ipc_send_entry *entries, int count) {
+    return handle_syscall(SYS_SEND_MSGV, (long)entries, count, 0, 0);
+}
+
+int syscall_recv_msgv(int sender_pid, struct ipc_recv_entry *entries, int count, int timeout_ms) {
+    return handle_syscall(SYS_RECV_MSGV, sender_pid, (long)entries, count, timeout_ms);
+}
+
+int syscall_set_queue_depth(int depth) {
+    return handle_syscall(SYS_SET_QUEUE_DEPTH, depth, 0, 0, 0);
+}
+
+int syscall_multicast(const int *receivers, int count, const void *data, int size) {
+    return handle_syscall(SYS_MULTICAST, (long)receivers, count, (long)data, size);
+}
+
+int syscall_call(int server_pid, struct ipc_regs *regs) {
+    return handle_syscall(SYS_CALL, server_pid, (long)regs, 0, 0);
+}
+
+int syscall_reply_wait(int reply_to, struct ipc_regs *regs) {
+    return handle_syscall(SYS_REPLY_WAIT, reply_to, (long)regs, 0, 0);
+}
+
+int syscall_grant_create(int grantee_pid, void *base, int size, int flags) {
+    return handle_syscall(SYS_GRANT_CREATE, grantee_pid, (long)base, size, flags);
+}
+
+void *syscall_grant_map(int handle, int flags, int *size) {
+    return (void*)handle_syscall(SYS_GRANT_MAP, handle, flags, (long)size, 0);
+}
+
+int syscall_grant_revoke(int handle) {
+    return handle_syscall(SYS_GRANT_REVOKE, handle, 0, 0, 0);
+}
+
+int syscall_notify(int pid, unsigned long bits) {
+    return handle_syscall(SYS_NOTIFY, pid, bits, 0, 0);
+}
+
+unsigned long syscall_notify_wait(unsigned long mask, int timeout_ms) {
+    return handle_syscall(SYS_NOTIFY_WAIT, mask, timeout_ms, 0, 0);
+}
+
+unsigned long syscall_notify_mask(unsigned long mask) {
+    return handle_syscall(SYS_NOTIFY_MASK, mask, 0, 0, 0);
+}
+
+int syscall_net_rx_notify(unsigned long bits) {
+    return handle_syscall(SYS_NET_RX_NOTIFY, bits, 0, 0, 0);
+}
+
 int syscall_net_send(const void *data, int size) {
     return handle_syscall(SYS_NET_SEND, (long)data, size, 0, 0);
 }
@@ -35,10 +92,67 @@ void syscall_yield(void) {
     handle_syscall(SYS_YIELD, 0, 0, 0, 0);
 }
 
+// Run pid next on the rest of our timeslice, if it is ready
+int syscall_yield_to(int pid) {
+    return handle_syscall(SYS_YIELD_TO, pid, 0, 0, 0);
+}
+
+// Sleep until mtime reaches deadline (see timer_now())
+int syscall_sleep_until(unsigned long deadline) {
+    return handle_syscall(SYS_SLEEP_UNTIL, (long)deadline, 0, 0, 0);
+}
+
+int syscall_sleep_ms(int ms) {
+    return syscall_sleep_until(timer_now() + MS_TO_TIMER_TICKS(ms));
+}
+
+// Arm user timer id (0..TASK_TIMERS-1) to post bits to the caller at deadline
+int syscall_timer_arm(int id, unsigned long deadline, unsigned long bits) {
+    return handle_syscall(SYS_TIMER_ARM, id, (long)deadline, (long)bits, 0);
+}
+
+int syscall_timer_cancel(int id) {
+    return handle_syscall(SYS_TIMER_CANCEL, id, 0, 0, 0);
+}
+
 int syscall_create_task(void (*entry_point)(void)) {
     return handle_syscall(SYS_CREATE_TASK, (long)entry_point, 0, 0, 0);
 }
 
+// Create a task with a stack of at least stack_size bytes (see STACK_MAX_SIZE)
+int syscall_create_task_stack(void (*entry_point)(void), unsigned int stack_size) {
+    return handle_syscall(SYS_CREATE_TASK, (long)entry_point, stack_size, 0, 0);
+}
+
+int syscall_set_affinity(int pid, unsigned long mask) {
+    return handle_syscall(SYS_SET_AFFINITY, pid, mask, 0, 0);
+}
+
+int syscall_set_priority(int pid, int priority) {
+    return handle_syscall(SYS_SET_PRIORITY, pid, priority, 0, 0);
+}
+
+// Reserve runtime_us of CPU every period_us for pid, due deadline_us into
+// each period (0 = at its end); runtime_us 0 returns pid to best effort
+int syscall_sched_edf(int pid, unsigned long runtime_us, unsigned long period_us, 
+                      unsigned long deadline_us) {
+    return handle_syscall(SYS_SCHED_EDF, pid, (long)runtime_us, (long)period_us, (long)deadline_us);
+}
+
+// Done with this period's job: sleep until the next period starts
+void syscall_edf_yield(void) {
+    handle_syscall(SYS_EDF_YIELD, 0, 0, 0, 0);
+}
+
+int syscall_hart_stats(int hart, struct hart_stats *stats) {
+    return handle_syscall(SYS_HART_STATS, hart, (long)stats, 0, 0);
+}
+
+// Fill stats with up to max live tasks; returns how many were written
+int syscall_task_stats(struct task_stats *stats, int max) {
+    return handle_syscall(SYS_TASK_STATS, (long)stats, max, 0, 0);
+}
+
 void syscall_exit(void) {
     handle_syscall(SYS_EXIT, 0, 0, 0, 0);
 }
@@ -6,6 +6,7 @@ extern int syscall_net_send(const void *data, int size);
 extern int syscall_net_recv(void *buffer, int max_size);
 extern int syscall_send_msg(int receiver_pid, const void *data, int size);
 extern int syscall_recv_msg(int sender_pid, void *buffer, int max_size);
+extern int syscall_recv_msg_timeout(int sender_pid, void *buffer, int max_size, int timeout_ms);
 
 // Socket descriptor structure
 struct socket_info {
@@ -30,6 +31,9 @@ static struct socket_info sockets[MAX_SOCKETS];
 // Network server PID (assuming it's known)
 #define NET_SERVER_PID 2
 
+// How long recv()/recvfrom() wait for the network server before giving up
+#define NET_RECV_TIMEOUT_MS 100
+
 // Socket creation
 int socket(int domain, int type, int protocol) {
     if (domain != AF_INET) {
@@ -172,7 +176,7 @@ int recv(int sockfd, void *buf, size_t len, int flags) {
     }
     
     // Receive from network server via IPC
-    return syscall_recv_msg(NET_SERVER_PID, buf, len);
+    return syscall_recv_msg_timeout(NET_SERVER_PID, buf, len, NET_RECV_TIMEOUT_MS);
 }
 
 // Send to specific address (UDP)
@@ -204,7 +208,7 @@ int recvfrom(int sockfd, void *buf, size_t len, int flags,
     }
     
     // Receive from network server via IPC
-    return syscall_recv_msg(NET_SERVER_PID, buf, len);
+    return syscall_recv_msg_timeout(NET_SERVER_PID, buf, len, NET_RECV_TIMEOUT_MS);
 }
 
 // Close socket
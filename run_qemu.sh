@@ -8,10 +8,7 @@ set -e
 KERNEL="kernel.elf"
 MACHINE="virt"
 MEMORY="128M"
-CPU_COUNT="1"
-
-# Default QEMU options
-QEMU_OPTS="-machine $MACHINE -m $MEMORY -smp $CPU_COUNT -nographic"
+CPU_COUNT="${CPU_COUNT:-1}"  # Harts; override with -c N or CPU_COUNT=N
 
 # Parse command line arguments
 DEBUG=false
@@ -33,6 +30,10 @@ while [[ $# -gt 0 ]]; do
             MONITOR=true
             shift
             ;;
+        -c|--cpus)
+            CPU_COUNT="$2"
+            shift 2
+            ;;
         -h|--help)
             HELP=true
             shift
@@ -53,6 +54,7 @@ if [ "$HELP" = true ]; then
     echo "  -d, --debug     Enable GDB server (listen on port 1234)"
     echo "  -n, --network   Enable network (virtio-net)"
     echo "  -m, --monitor   Enable QEMU monitor console"
+    echo "  -c, --cpus N    Number of harts (1-8, default 1)"
     echo "  -h, --help      Show this help message"
     echo ""
     echo "Examples:"
@@ -60,6 +62,7 @@ if [ "$HELP" = true ]; then
     echo "  $0 -d           # Debug mode"
     echo "  $0 -n           # With network"
     echo "  $0 -d -n        # Debug with network"
+    echo "  $0 -c 4         # Four harts"
     echo ""
     echo "In debug mode, connect GDB with:"
     echo "  riscv64-unknown-elf-gdb kernel.elf"
@@ -68,6 +71,9 @@ if [ "$HELP" = true ]; then
     exit 0
 fi
 
+# Default QEMU options
+QEMU_OPTS="-machine $MACHINE -m $MEMORY -smp $CPU_COUNT -nographic"
+
 # Check if kernel exists
 if [ ! -f "$KERNEL" ]; then
     echo "Error: $KERNEL not found. Please build the kernel first with 'make'"
@@ -1,5 +1,7 @@
 #include "../kernal/syscall.h"
 #include "../kernal/printk.h"
+#include "../kernal/ipc.h"
+#include "../kernal/sched.h"
 #include <stddef.h>
 
 // Bullet server - handles process migration
@@ -8,6 +10,10 @@
 static int BULLET_SERVER_PID = 3; // Bullet server gets PID 3
 #define MAX_MIGRATION_REQUESTS 16
 
+// Commands, carried in mr[0] of a call; arguments follow in mr[1..]
+#define BULLET_CMD_MIGRATE 1  // mr[1] = target node, mr[2] = process size
+#define BULLET_CMD_STATUS  2  // mr[1] = request ID
+
 // Migration request structure
 struct migration_request {
     int source_pid;
@@ -85,60 +91,60 @@ void process_migrations(void) {
     }
 }
 
-// Handle messages from clients
-void bullet_handle_client_message(int sender_pid, char *msg_data, int msg_size) {
-    if (msg_size < 4) return;
-    
-    int *cmd = (int*)msg_data;
+// Serve one call. Requests fit in the message registers, so the request and
+// its one-word answer travel through the TCBs without a message allocation.
+// Returns the answer.
+long bullet_handle_call(int caller_pid, struct ipc_regs *regs) {
+    if (regs->count < 2) {
+        printk("[bullet] Short request from PID %d\n", caller_pid);
+        return -1;
+    }
     
-    switch (*cmd) {
-        case 1: // Migration request
-            if (msg_size >= 16) {
-                int *args = (int*)msg_data;
-                int target_node = args[1];
-                int data_size = args[2];
-                void *data = (void*)&args[3];
-                
-                int req_id = handle_migration_request(sender_pid, target_node, data, data_size);
-                
-                // Send response back to client with error handling
-                if (syscall_send_msg(sender_pid, &req_id, sizeof(req_id)) < 0) {
-                    printk("[bullet] Failed to send migration response to PID %d\n", sender_pid);
-                }
+    switch (regs->mr[0]) {
+        case BULLET_CMD_MIGRATE:
+            if (regs->count >= 3) {
+                // The image itself would move by grant; only its size is passed
+                return handle_migration_request(caller_pid, (int)regs->mr[1], 0, (int)regs->mr[2]);
             }
             break;
             
-        case 2: // Migration status query
-            if (msg_size >= 8) {
-                int req_id = ((int*)msg_data)[1];
-                if (req_id >= 0 && req_id < bullet.num_requests) {
-                    int status = bullet.requests[req_id].status;
-                    if (syscall_send_msg(sender_pid, &status, sizeof(status)) < 0) {
-                        printk("[bullet] Failed to send status response to PID %d\n", sender_pid);
-                    }
-                } else {
-                    int error_status = -1;
-                    syscall_send_msg(sender_pid, &error_status, sizeof(error_status));
-                }
+        case BULLET_CMD_STATUS: {
+            long req_id = (long)regs->mr[1];
+            if (req_id >= 0 && req_id < bullet.num_requests) {
+                return bullet.requests[req_id].status;
             }
             break;
+        }
             
         default:
-            printk("[bullet] Unknown command from PID %d: %d\n", sender_pid, *cmd);
+            printk("[bullet] Unknown command from PID %d: %ld\n", caller_pid, (long)regs->mr[0]);
             break;
     }
+    
+    return -1;
 }
 
 // Main bullet server loop
 void bullet_server_main(void) {
     bullet_init();
     
+    // Requests are latency-critical; run ahead of bulk compute tasks
+    syscall_set_priority(syscall_get_pid(), SCHED_PRIO_SERVER);
+    
     printk("[bullet] Bullet server starting main loop\n");
     
-    char msg_buffer[256];
+    struct ipc_regs regs;
+    int caller = -1;
     int loop_count = 0;
     
     while (bullet.active) {
+        // Answer the previous caller and wait for the next one in one kernel
+        // entry; the reply switches straight back to the client
+        caller = syscall_reply_wait(caller, &regs);
+        if (caller < 0) {
+            continue;
+        }
+        
         loop_count++;
         
         // Debug output every 1000 iterations
@@ -146,83 +152,44 @@ void bullet_server_main(void) {
             printk("[bullet] Server loop iteration %d\n", loop_count);
         }
         
-        // Check for incoming messages
-        int msg_size = syscall_recv_msg(-1, msg_buffer, sizeof(msg_buffer)); // -1 = any sender
-        
-        if (msg_size > 0) {
-            printk("[bullet] Received message of %d bytes\n", msg_size);
-            int sender_pid = ((int*)msg_buffer)[0]; // First int is sender PID
-            bullet_handle_client_message(sender_pid, msg_buffer + 4, msg_size - 4);
-        }
+        long answer = bullet_handle_call(caller, &regs);
         
         // Process pending migrations
         process_migrations();
         
-        // Yield to other tasks
-        syscall_yield();
+        regs.count = 1;
+        regs.mr[0] = (unsigned long)answer;
     }
     
     printk("[bullet] Bullet server shutting down\n");
 }
 
+// Call the bullet server and return its one-word answer, or -1
+static long bullet_call(unsigned long cmd, unsigned long arg1, unsigned long arg2, int count) {
+    struct ipc_regs regs;
+    regs.count = count;
+    regs.mr[0] = cmd;
+    regs.mr[1] = arg1;
+    regs.mr[2] = arg2;
+    
+    if (syscall_call(BULLET_SERVER_PID, &regs) < 0 || regs.count < 1) {
+        return -1;
+    }
+    return (long)regs.mr[0];
+}
+
 // API functions for clients to use bullet server
 int bullet_migrate_process(int target_node, void *process_data, int size) {
-    int cmd_data[4];
-    cmd_data[0] = syscall_get_pid(); // sender PID
-    cmd_data[1] = 1; // migration request command
-    cmd_data[2] = target_node;
-    cmd_data[3] = size;
-    
-    // Send request to bullet server with retry logic
-    int retries = 3;
-    while (retries > 0) {
-        if (syscall_send_msg(BULLET_SERVER_PID, cmd_data, sizeof(cmd_data)) >= 0) {
-            break;
-        }
-        retries--;
-        // Simple delay before retry
-        for (volatile int i = 0; i < 1000; i++);
-    }
-    
-    if (retries == 0) {
-        printk("[bullet-client] Failed to send migration request after retries\n");
-        return -1;
+    long req_id = bullet_call(BULLET_CMD_MIGRATE, target_node, size, 3);
+    if (req_id < 0) {
+        printk("[bullet-client] Migration request failed\n");
     }
-    
-    // Wait for response
-    int req_id = -1;
-    syscall_recv_msg(BULLET_SERVER_PID, &req_id, sizeof(req_id));
-    
-    return req_id;
+    return (int)req_id;
 }
 
 int bullet_check_migration_status(int req_id) {
-    int cmd_data[3];
-    cmd_data[0] = syscall_get_pid(); // sender PID
-    cmd_data[1] = 2; // status query command
-    cmd_data[2] = req_id;
-    
-    // Send request to bullet server with retry logic
-    int retries = 3;
-    while (retries > 0) {
-        if (syscall_send_msg(BULLET_SERVER_PID, cmd_data, sizeof(cmd_data)) >= 0) {
-            break;
-        }
-        retries--;
-        // Simple delay before retry
-        for (volatile int i = 0; i < 1000; i++);
-    }
-    
-    if (retries == 0) {
-        printk("[bullet-client] Failed to send status request after retries\n");
-        return -1;
-    }
-    
-    // Wait for response
-    int status = -1;
-    syscall_recv_msg(BULLET_SERVER_PID, &status, sizeof(status));
-    
-    return status;
+    long status = bullet_call(BULLET_CMD_STATUS, req_id, 0, 2);
+    return (int)status;
 }
 
 // Get the bullet server PID
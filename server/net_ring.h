@@ -0,0 +1,62 @@
+#ifndef NET_RING_H
+#define NET_RING_H
+
+#include <stdint.h>
+
+// Submission/completion rings between a client and the network server.
+// The client owns the ring memory and grants it to the server once; after
+// that requests and completions move through shared memory, and the only
+// kernel entries are doorbell notifications when a ring goes from empty to
+// non-empty.
+
+#define NET_RING_ENTRIES  32   // Power of two
+#define NET_RING_MASK     (NET_RING_ENTRIES - 1)
+#define NET_RING_BUF_SIZE 256  // Data buffer per slot
+
+#define NET_NOTIFY_SQ 0x2  // Server doorbell: a submission ring became non-empty
+#define NET_NOTIFY_CQ 0x1  // Default client doorbell: the completion ring became non-empty
+
+// Ring opcodes
+#define NET_OP_NOP   0
+#define NET_OP_SEND  1
+#define NET_OP_RECV  2
+#define NET_OP_CLOSE 3
+
+// Submission entry; the payload lives in data[index] of the ring
+struct net_sqe {
+    int opcode;
+    int sock_id;
+    int len;
+    int index;               // Buffer slot for the payload or received data
+    unsigned long user_data; // Returned untouched in the completion
+};
+
+// Completion entry
+struct net_cqe {
+    int result;              // Bytes sent/received, 0, or -1
+    int index;               // Buffer slot holding received data
+    unsigned long user_data;
+};
+
+// Shared ring. sq_tail/cq_head are written only by the client, sq_head/cq_tail
+// only by the server; indices run freely and are masked on access.
+struct net_ring {
+    unsigned int sq_head, sq_tail;
+    unsigned int cq_head, cq_tail;
+    int client_pid;
+    int grant_handle;              // Client bookkeeping for teardown
+    unsigned long cq_notify_bits;  // Notification bits the server rings
+    struct net_sqe sq[NET_RING_ENTRIES];
+    struct net_cqe cq[NET_RING_ENTRIES];
+    uint8_t data[NET_RING_ENTRIES][NET_RING_BUF_SIZE];
+};
+
+static inline unsigned int net_ring_load(const unsigned int *index) {
+    return __atomic_load_n(index, __ATOMIC_ACQUIRE);
+}
+
+static inline void net_ring_store(unsigned int *index, unsigned int value) {
+    __atomic_store_n(index, value, __ATOMIC_RELEASE);
+}
+
+#endif
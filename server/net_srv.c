@@ -1,5 +1,9 @@
 #include "../kernal/syscall.h"
 #include "../kernal/printk.h"
+#include "../kernal/ipc.h"
+#include "../kernal/sched.h"
+#include "../lib/libc/libc.h"
+#include "net_ring.h"
 #include <stddef.h>
 #include <stdint.h>
 
@@ -9,6 +13,12 @@
 static int NET_SERVER_PID = 4; // Network server gets PID 4
 #define MAX_SOCKETS 32
 #define MAX_CONNECTIONS 16
+#define NET_NOTIFY_RX 0x1        // Notification bit set by the driver on packet arrival
+#define NET_MAX_FRAME 1514       // Largest frame the driver accepts
+#define NET_INLINE_SEND_MAX 240  // Payloads above this go through a memory grant
+#define MAX_NET_RINGS 4
+#define NET_RETRY_DELAY_MS 2     // Back-off before resending to a full server queue
+#define NET_RING_RETRY_MS 1      // Re-poll interval while a client's completion ring is full
 
 // Socket types
 typedef enum {
@@ -39,10 +49,21 @@ struct socket {
     int in_use;
 };
 
+// Submission/completion ring registered by a client
+struct ring_binding {
+    struct net_ring *ring;  // 0 when the slot is free
+    int client_pid;
+    int handle;             // Grant the ring was mapped through
+    unsigned int sq_head;   // Server-owned indices; the shared copies are
+    unsigned int cq_tail;   // only published, never read back
+    int stalled;            // Submissions left because the completion ring is full
+};
+
 // Network server state
 struct net_server {
     int server_pid;
     struct socket sockets[MAX_SOCKETS];
+    struct ring_binding rings[MAX_NET_RINGS];
     int next_socket_id;
     int active;
 };
@@ -64,6 +85,15 @@ void net_server_init(void) {
         netserv.sockets[i].rx_count = 0;
     }
     
+    for (int i = 0; i < MAX_NET_RINGS; i++) {
+        netserv.rings[i].ring = 0;
+    }
+    
+    // Let the driver wake us on packet arrival instead of polling, and let
+    // ring doorbells end a blocking receive the same way
+    syscall_net_rx_notify(NET_NOTIFY_RX);
+    syscall_notify_mask(NET_NOTIFY_RX | NET_NOTIFY_SQ);
+    
     printk("[netserv] Network server initialized (PID: %d)\n", netserv.server_pid);
 }
 
@@ -168,6 +198,28 @@ int send_socket_data(int sock_id, const void *data, int len) {
     return result;
 }
 
+// Send a client buffer exposed through a memory grant, read in place
+int send_granted_data(int sock_id, int handle, int len) {
+    int grant_size = 0;
+    const uint8_t *data = (const uint8_t*)syscall_grant_map(handle, GRANT_READ, &grant_size);
+    if (!data || len < 0 || len > grant_size) {
+        printk("[netserv] Invalid grant %d for socket %d\n", handle, sock_id);
+        return -1;
+    }
+    
+    // Split into frames the driver can take
+    int sent = 0;
+    while (sent < len) {
+        int frame = (len - sent > NET_MAX_FRAME) ? NET_MAX_FRAME : (len - sent);
+        if (send_socket_data(sock_id, data + sent, frame) < 0) {
+            return sent > 0 ? sent : -1;
+        }
+        sent += frame;
+    }
+    
+    return sent;
+}
+
 // Receive data from socket
 int recv_socket_data(int sock_id, void *buffer, int max_len) {
     struct socket *sock = find_socket(sock_id);
@@ -206,9 +258,9 @@ void socket_add_rx_data(struct socket *sock, const void *data, int len) {
 // Process network packets and route to appropriate sockets
 void process_network_packets(void) {
     uint8_t packet_buffer[1500];
-    int packet_len = syscall_net_recv(packet_buffer, sizeof(packet_buffer));
+    int packet_len;
     
-    if (packet_len > 0) {
+    while ((packet_len = syscall_net_recv(packet_buffer, sizeof(packet_buffer))) > 0) {
         printk("[netserv] Received network packet: %d bytes\n", packet_len);
         
         // Simple packet routing - in a real implementation, this would
@@ -224,6 +276,160 @@ void process_network_packets(void) {
     }
 }
 
+// A client that exits without unregistering has its grants revoked by the
+// kernel; once the handle no longer maps to the ring, the memory is not ours
+static int ring_still_granted(struct ring_binding *binding) {
+    int size = 0;
+    void *ring = syscall_grant_map(binding->handle, GRANT_READ | GRANT_WRITE, &size);
+    return ring == binding->ring && size >= (int)sizeof(struct net_ring);
+}
+
+// Map a client's ring through its grant and start serving it
+int register_ring(int client_pid, int handle) {
+    int size = 0;
+    struct net_ring *ring = (struct net_ring*)syscall_grant_map(handle, GRANT_READ | GRANT_WRITE, &size);
+    if (!ring || size < (int)sizeof(struct net_ring) || ring->client_pid != client_pid) {
+        printk("[netserv] Invalid ring grant %d from PID %d\n", handle, client_pid);
+        return -1;
+    }
+    
+    // Slots of clients that exited without unregistering are reusable
+    for (int i = 0; i < MAX_NET_RINGS; i++) {
+        if (!netserv.rings[i].ring || !ring_still_granted(&netserv.rings[i])) {
+            netserv.rings[i].ring = ring;
+            netserv.rings[i].client_pid = client_pid;
+            netserv.rings[i].handle = handle;
+            netserv.rings[i].sq_head = ring->sq_head;
+            netserv.rings[i].cq_tail = ring->cq_tail;
+            netserv.rings[i].stalled = 0;
+            printk("[netserv] Registered ring %d for PID %d\n", i, client_pid);
+            return i;
+        }
+    }
+    
+    printk("[netserv] No free ring slots for PID %d\n", client_pid);
+    return -1;
+}
+
+int unregister_ring(int client_pid, int handle) {
+    for (int i = 0; i < MAX_NET_RINGS; i++) {
+        struct ring_binding *binding = &netserv.rings[i];
+        if (binding->ring && binding->client_pid == client_pid && binding->handle == handle) {
+            binding->ring = 0;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Run one submission against the sockets; data is read from or written to
+// the entry's buffer slot in the shared ring. sqe must be a private copy:
+// the client can rewrite the ring entry between the check and the use.
+static int execute_sqe(struct net_ring *ring, const struct net_sqe *sqe) {
+    if (sqe->index < 0 || sqe->index >= NET_RING_ENTRIES ||
+        sqe->len < 0 || sqe->len > NET_RING_BUF_SIZE) {
+        return -1;
+    }
+    
+    switch (sqe->opcode) {
+        case NET_OP_NOP:
+            return 0;
+        case NET_OP_SEND:
+            return send_socket_data(sqe->sock_id, ring->data[sqe->index], sqe->len);
+        case NET_OP_RECV:
+            return recv_socket_data(sqe->sock_id, ring->data[sqe->index], sqe->len);
+        case NET_OP_CLOSE:
+            close_socket(sqe->sock_id);
+            return 0;
+        default:
+            printk("[netserv] Unknown ring opcode from PID %d: %d\n", ring->client_pid, sqe->opcode);
+            return -1;
+    }
+}
+
+// Drain one client's submission ring. sq_tail and cq_head are written by the
+// client and may be garbage: at most one ring's worth of submissions is
+// taken per pass, and draining stops while the completion ring is full.
+static void process_ring(struct ring_binding *binding) {
+    struct net_ring *ring = binding->ring;
+    unsigned int head = binding->sq_head;
+    unsigned int cq_tail = binding->cq_tail;
+    unsigned int tail;
+    
+    binding->stalled = 0;
+    
+    // Re-read the tail after publishing our head so a submission that raced
+    // with the drain is either seen here or rings the doorbell again
+    while ((tail = net_ring_load(&ring->sq_tail)) != head) {
+        unsigned int old_cq_tail = cq_tail;
+        unsigned int cq_head = net_ring_load(&ring->cq_head);
+        int clamped = 0;
+        
+        if (tail - head > NET_RING_ENTRIES) {
+            printk("[netserv] Ring of PID %d claims %u submissions, clamping\n", 
+                   binding->client_pid, tail - head);
+            tail = head + NET_RING_ENTRIES;
+            clamped = 1;
+        }
+        
+        for (; head != tail; head++, cq_tail++) {
+            if (cq_tail - cq_head >= NET_RING_ENTRIES) {
+                break;  // Completion ring full until the client reaps
+            }
+            
+            // Snapshot the entry once; the barrier keeps the compiler from
+            // going back to the shared copy for any field
+            struct net_sqe sqe = ring->sq[head & NET_RING_MASK];
+            __atomic_signal_fence(__ATOMIC_SEQ_CST);
+            
+            struct net_cqe *cqe = &ring->cq[cq_tail & NET_RING_MASK];
+            cqe->result = execute_sqe(ring, &sqe);
+            cqe->index = sqe.index;
+            cqe->user_data = sqe.user_data;
+        }
+        
+        binding->sq_head = head;
+        binding->cq_tail = cq_tail;
+        net_ring_store(&ring->cq_tail, cq_tail);
+        net_ring_store(&ring->sq_head, head);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        
+        // Doorbell only when the completion ring was empty
+        if (cq_tail != old_cq_tail && net_ring_load(&ring->cq_head) == old_cq_tail) {
+            syscall_notify(binding->client_pid, ring->cq_notify_bits);
+        }
+        
+        if (head != tail) {
+            // The client will not ring again for submissions already queued,
+            // so the main loop re-polls this ring until they drain
+            binding->stalled = 1;
+            return;
+        }
+        if (clamped) {
+            return;  // Do not chase a bogus tail around the ring
+        }
+    }
+}
+
+// Returns the number of rings left with submissions they could not complete
+int process_rings(void) {
+    int stalled = 0;
+    for (int i = 0; i < MAX_NET_RINGS; i++) {
+        struct ring_binding *binding = &netserv.rings[i];
+        if (!binding->ring) continue;
+        
+        if (!ring_still_granted(binding)) {
+            printk("[netserv] Dropping ring %d of PID %d: grant revoked\n", i, binding->client_pid);
+            binding->ring = 0;
+            continue;
+        }
+        
+        process_ring(binding);
+        stalled += binding->stalled;
+    }
+    return stalled;
+}
+
 // Handle messages from clients
 void net_handle_client_message(int sender_pid, char *msg_data, int msg_size) {
     if (msg_size < 4) return;
@@ -296,6 +502,28 @@ void net_handle_client_message(int sender_pid, char *msg_data, int msg_size) {
             }
             break;
             
+        case 8: // send() - payload passed by memory grant
+            if (msg_size >= 16) {
+                int *args = (int*)msg_data;
+                int sock_id = args[1];
+                int handle = args[2];
+                int len = args[3];
+                response = send_granted_data(sock_id, handle, len);
+            }
+            break;
+            
+        case 9: // register a submission/completion ring passed by grant
+            if (msg_size >= 8) {
+                response = register_ring(sender_pid, ((int*)msg_data)[1]);
+            }
+            break;
+            
+        case 10: // unregister a ring
+            if (msg_size >= 8) {
+                response = unregister_ring(sender_pid, ((int*)msg_data)[1]);
+            }
+            break;
+            
         default:
             printk("[netserv] Unknown command from PID %d: %d\n", sender_pid, *cmd);
             break;
@@ -309,10 +537,14 @@ void net_handle_client_message(int sender_pid, char *msg_data, int msg_size) {
 void net_server_main(void) {
     net_server_init();
     
+    // Requests are latency-critical; run ahead of bulk compute tasks
+    syscall_set_priority(syscall_get_pid(), SCHED_PRIO_SERVER);
+    
     printk("[netserv] Network server starting main loop\n");
     
     char msg_buffer[256];
     int loop_count = 0;
+    int rings_stalled = 0;
     
     while (netserv.active) {
         loop_count++;
@@ -322,20 +554,27 @@ void net_server_main(void) {
             printk("[netserv] Server loop iteration %d\n", loop_count);
         }
         
-        // Check for incoming messages from clients
-        int msg_size = syscall_recv_msg(-1, msg_buffer, sizeof(msg_buffer)); // -1 = any sender
+        // Block until a client message or an RX notification arrives; while a
+        // ring is stalled on a full completion ring, wake up to retry it
+        int msg_size = syscall_recv_msg_timeout(-1, msg_buffer, sizeof(msg_buffer), // -1 = any sender
+                                                rings_stalled ? NET_RING_RETRY_MS : IPC_WAIT_FOREVER);
         
-        if (msg_size > 0) {
+        if (msg_size == IPC_NOTIFIED) {
+            // Consume the bits, then serve whatever they announced
+            unsigned long bits = syscall_notify_wait(NET_NOTIFY_RX | NET_NOTIFY_SQ, IPC_NO_WAIT);
+            if (bits & NET_NOTIFY_RX) {
+                process_network_packets();
+            }
+            if ((bits & NET_NOTIFY_SQ) || rings_stalled) {
+                rings_stalled = process_rings();
+            }
+        } else if (msg_size < 0 && rings_stalled) {
+            rings_stalled = process_rings();
+        } else if (msg_size > 0) {
             printk("[netserv] Received message of %d bytes\n", msg_size);
             int sender_pid = ((int*)msg_buffer)[0]; // First int is sender PID
             net_handle_client_message(sender_pid, msg_buffer + 4, msg_size - 4);
         }
-        
-        // Process incoming network packets
-        process_network_packets();
-        
-        // Yield to other tasks
-        syscall_yield();
     }
     
     printk("[netserv] Network server shutting down\n");
@@ -355,7 +594,7 @@ int net_socket(socket_type_t type) {
             break;
         }
         retries--;
-        for (volatile int i = 0; i < 1000; i++); // delay
+        syscall_sleep_ms(NET_RETRY_DELAY_MS); // back off
     }
     
     if (retries == 0) {
@@ -383,7 +622,7 @@ int net_bind(int sock_id, uint32_t ip, uint16_t port) {
             break;
         }
         retries--;
-        for (volatile int i = 0; i < 1000; i++); // delay
+        syscall_sleep_ms(NET_RETRY_DELAY_MS); // back off
     }
     
     if (retries == 0) {
@@ -397,28 +636,57 @@ int net_bind(int sock_id, uint32_t ip, uint16_t port) {
     return result;
 }
 
+// Large sends: grant the server read access to the buffer and pass only the
+// handle, so the cost does not depend on the payload size
+int net_socket_send_granted(int sock_id, const void *data, int len) {
+    int handle = syscall_grant_create(NET_SERVER_PID, (void*)data, len, GRANT_READ);
+    if (handle < 0) {
+        printk("[net-client] Failed to grant %d byte send buffer\n", len);
+        return -1;
+    }
+    
+    int cmd_data[5];
+    cmd_data[0] = syscall_get_pid();
+    cmd_data[1] = 8; // granted send command
+    cmd_data[2] = sock_id;
+    cmd_data[3] = handle;
+    cmd_data[4] = len;
+    
+    int result = -1;
+    if (syscall_send_msg(NET_SERVER_PID, cmd_data, sizeof(cmd_data)) >= 0) {
+        // The server is done with the buffer once it has replied
+        syscall_recv_msg(NET_SERVER_PID, &result, sizeof(result));
+    } else {
+        printk("[net-client] Failed to send granted send request\n");
+    }
+    
+    syscall_grant_revoke(handle);
+    return result;
+}
+
 int net_socket_send(int sock_id, const void *data, int len) {
-    // Simplified - in reality would need to handle larger data
+    if (len > NET_INLINE_SEND_MAX) {
+        return net_socket_send_granted(sock_id, data, len);
+    }
+    
     int cmd_data[64]; // enough for small messages
     cmd_data[0] = syscall_get_pid();
     cmd_data[1] = 5; // send command
     cmd_data[2] = sock_id;
     cmd_data[3] = len;
     
-    // Copy data (limited by buffer size)
-    int copy_len = (len < 240) ? len : 240; // leave room for header
-    for (int i = 0; i < copy_len; i++) {
+    for (int i = 0; i < len; i++) {
         ((char*)&cmd_data[4])[i] = ((const char*)data)[i];
     }
     
     // Send with retry logic
     int retries = 3;
     while (retries > 0) {
-        if (syscall_send_msg(NET_SERVER_PID, cmd_data, 16 + copy_len) >= 0) {
+        if (syscall_send_msg(NET_SERVER_PID, cmd_data, 16 + len) >= 0) {
             break;
         }
         retries--;
-        for (volatile int i = 0; i < 1000; i++); // delay
+        syscall_sleep_ms(NET_RETRY_DELAY_MS); // back off
     }
     
     if (retries == 0) {
@@ -432,6 +700,120 @@ int net_socket_send(int sock_id, const void *data, int len) {
     return result;
 }
 
+// Set up a submission/completion ring with the server. Completions ring
+// cq_notify_bits on the caller (0 = NET_NOTIFY_CQ).
+struct net_ring *net_ring_setup(unsigned long cq_notify_bits) {
+    struct net_ring *ring = (struct net_ring*)malloc(sizeof(struct net_ring));
+    if (!ring) {
+        printk("[net-client] Failed to allocate ring\n");
+        return 0;
+    }
+    
+    ring->sq_head = ring->sq_tail = 0;
+    ring->cq_head = ring->cq_tail = 0;
+    ring->client_pid = syscall_get_pid();
+    ring->cq_notify_bits = cq_notify_bits ? cq_notify_bits : NET_NOTIFY_CQ;
+    
+    int handle = syscall_grant_create(NET_SERVER_PID, ring, sizeof(struct net_ring), 
+                                      GRANT_READ | GRANT_WRITE);
+    if (handle < 0) {
+        printk("[net-client] Failed to grant ring to the network server\n");
+        free(ring);
+        return 0;
+    }
+    
+    int cmd_data[3];
+    cmd_data[0] = ring->client_pid;
+    cmd_data[1] = 9; // register ring command
+    cmd_data[2] = handle;
+    
+    int result = -1;
+    if (syscall_send_msg(NET_SERVER_PID, cmd_data, sizeof(cmd_data)) >= 0) {
+        syscall_recv_msg(NET_SERVER_PID, &result, sizeof(result));
+    }
+    
+    if (result < 0) {
+        printk("[net-client] Network server rejected ring\n");
+        syscall_grant_revoke(handle);
+        free(ring);
+        return 0;
+    }
+    
+    ring->grant_handle = handle;
+    return ring;
+}
+
+void net_ring_teardown(struct net_ring *ring) {
+    int cmd_data[3];
+    cmd_data[0] = ring->client_pid;
+    cmd_data[1] = 10; // unregister ring command
+    cmd_data[2] = ring->grant_handle;
+    
+    int result = -1;
+    if (syscall_send_msg(NET_SERVER_PID, cmd_data, sizeof(cmd_data)) >= 0) {
+        syscall_recv_msg(NET_SERVER_PID, &result, sizeof(result));
+    }
+    
+    syscall_grant_revoke(ring->grant_handle);
+    free(ring);
+}
+
+// Queue a request. Send payloads are copied into the entry's buffer slot;
+// receives land there. Only rings the server's doorbell if the submission
+// ring was empty. Returns -1 if the ring is full or the request is invalid.
+int net_ring_submit(struct net_ring *ring, int opcode, int sock_id, 
+                    const void *data, int len, unsigned long user_data) {
+    unsigned int tail = ring->sq_tail;
+    
+    // Bound in-flight requests so neither ring nor buffer slot is overrun
+    if (tail - ring->cq_head >= NET_RING_ENTRIES) return -1;
+    if (len < 0 || len > NET_RING_BUF_SIZE) return -1;
+    
+    struct net_sqe *sqe = &ring->sq[tail & NET_RING_MASK];
+    sqe->opcode = opcode;
+    sqe->sock_id = sock_id;
+    sqe->len = len;
+    sqe->index = tail & NET_RING_MASK;
+    sqe->user_data = user_data;
+    
+    if (opcode == NET_OP_SEND) {
+        if (!data) return -1;
+        for (int i = 0; i < len; i++) {
+            ring->data[sqe->index][i] = ((const uint8_t*)data)[i];
+        }
+    }
+    
+    net_ring_store(&ring->sq_tail, tail + 1);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    
+    if (net_ring_load(&ring->sq_head) == tail) {
+        syscall_notify(NET_SERVER_PID, NET_NOTIFY_SQ);
+    }
+    
+    return 0;
+}
+
+// Take one completion without entering the kernel. Received data is in
+// ring->data[cqe->index] until the next submission. Returns 1 or 0 if empty.
+int net_ring_reap(struct net_ring *ring, struct net_cqe *cqe) {
+    unsigned int head = ring->cq_head;
+    if (head == net_ring_load(&ring->cq_tail)) return 0;
+    
+    *cqe = ring->cq[head & NET_RING_MASK];
+    net_ring_store(&ring->cq_head, head + 1);
+    return 1;
+}
+
+// Reap a completion, sleeping on the completion doorbell while none is ready
+int net_ring_wait(struct net_ring *ring, struct net_cqe *cqe, int timeout_ms) {
+    while (!net_ring_reap(ring, cqe)) {
+        if (!syscall_notify_wait(ring->cq_notify_bits, timeout_ms)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
 // Get the network server PID
 int net_get_server_pid(void) {
     return NET_SERVER_PID;
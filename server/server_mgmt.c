@@ -2,6 +2,9 @@
 #include "../kernal/syscall.h"
 #include "../kernal/printk.h"
 
+#define DEMO_RING_REQUESTS 16      // Requests pushed through the ring demo
+#define DEMO_RING_TIMEOUT_MS 100
+
 // Global server PID storage
 static int g_bullet_server_pid = -1;
 static int g_net_server_pid = -1;
@@ -32,6 +35,42 @@ void start_servers(void) {
     printk("[servers] All servers started\n");
 }
 
+// Push a burst of requests through a submission/completion ring: one doorbell
+// starts the server on the whole burst, and every request must come back
+// exactly once with its own user_data
+static int ring_demo(int sock) {
+    struct net_ring *ring = net_ring_setup(0);
+    if (!ring) {
+        return -1;
+    }
+    
+    char msg[] = "Hello, Ring!";
+    int submitted = 0;
+    for (int i = 0; i < DEMO_RING_REQUESTS; i++) {
+        int opcode = (i == DEMO_RING_REQUESTS - 1) ? NET_OP_SEND : NET_OP_NOP;
+        if (net_ring_submit(ring, opcode, sock, msg, sizeof(msg), i) < 0) {
+            printk("[demo] Ring submit %d failed\n", i);
+            break;
+        }
+        submitted++;
+    }
+    
+    unsigned long seen = 0;
+    int completed = 0;
+    struct net_cqe cqe;
+    while (completed < submitted && net_ring_wait(ring, &cqe, DEMO_RING_TIMEOUT_MS)) {
+        if (cqe.user_data < DEMO_RING_REQUESTS && !(seen & (1UL << cqe.user_data))) {
+            seen |= 1UL << cqe.user_data;
+            completed++;
+        }
+    }
+    
+    net_ring_teardown(ring);
+    
+    printk("[demo] Ring: %d/%d requests completed\n", completed, DEMO_RING_REQUESTS);
+    return (completed == DEMO_RING_REQUESTS) ? 0 : -1;
+}
+
 // Demo function to test server functionality
 void server_demo(void) {
     printk("[demo] Starting server demonstration...\n");
@@ -42,8 +81,8 @@ void server_demo(void) {
     int req_id = bullet_migrate_process(2, test_data, sizeof(test_data));
     printk("[demo] Migration request ID: %d\n", req_id);
     
-    // Wait a bit and check status - increased delay to reduce message frequency
-    for (volatile int i = 0; i < 50000; i++); // increased delay
+    // Wait a bit and check status - spaced out to reduce message frequency
+    syscall_sleep_ms(5);
     int status = bullet_check_migration_status(req_id);
     printk("[demo] Migration status: %d\n", status);
     
@@ -63,6 +102,9 @@ void server_demo(void) {
         } else {
             printk("[demo] Bind failed: %d\n", bind_result);
         }
+        
+        printk("[demo] Testing submission/completion ring...\n");
+        printk("CHECK net_ring %s\n", ring_demo(sock) == 0 ? "ok" : "FAIL");
     }
     
     printk("[demo] Server demonstration completed\n");
@@ -74,13 +116,13 @@ void test_client_main(void) {
     printk("[client] Test client started (PID: %d)\n", my_pid);
     
     // Give servers more time to start and initialize
-    for (volatile int i = 0; i < 100000; i++);
+    syscall_sleep_ms(10);
     
     // Run the demo once - avoid repeated testing that exhausts message slots
     server_demo();
     
     // Add a longer delay before potential exit to let messages clear
-    for (volatile int i = 0; i < 50000; i++);
+    syscall_sleep_ms(5);
     
     printk("[client] Test client finished\n");
 }
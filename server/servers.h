@@ -2,6 +2,7 @@
 #define SERVERS_H
 
 #include <stdint.h>
+#include "net_ring.h"
 
 // Bullet server API
 int bullet_migrate_process(int target_node, void *process_data, int size);
@@ -18,9 +19,18 @@ typedef enum {
 int net_socket(socket_type_t type);
 int net_bind(int sock_id, uint32_t ip, uint16_t port);
 int net_socket_send(int sock_id, const void *data, int len);
+int net_socket_send_granted(int sock_id, const void *data, int len);
 int net_get_server_pid(void);
 void net_server_main(void);
 
+// Submission/completion ring API (see net_ring.h)
+struct net_ring *net_ring_setup(unsigned long cq_notify_bits);
+void net_ring_teardown(struct net_ring *ring);
+int net_ring_submit(struct net_ring *ring, int opcode, int sock_id, 
+                    const void *data, int len, unsigned long user_data);
+int net_ring_reap(struct net_ring *ring, struct net_cqe *cqe);
+int net_ring_wait(struct net_ring *ring, struct net_cqe *cqe, int timeout_ms);
+
 // Server management
 void start_servers(void);
 void server_demo(void);